@@ -3209,6 +3209,68 @@ static void test_delete_key_value(void)
     RegCloseKey(subkey);
 }
 
+static void test_many_subkeys(void)
+{
+    char name[32], prev[32];
+    HKEY key, subkey;
+    DWORD i, size;
+    LONG ret;
+
+    ret = RegCreateKeyExA(hkey_main, "ManySubkeys", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, NULL);
+    ok(!ret, "RegCreateKeyExA failed with error %d\n", ret);
+
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(name, "Key%03u", (i * 7) % 500);
+        ret = RegCreateKeyA(key, name, &subkey);
+        ok(!ret, "RegCreateKeyA %s failed with error %d\n", name, ret);
+        RegCloseKey(subkey);
+    }
+
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(name, "kEY%03u", i);
+        ret = RegOpenKeyA(key, name, &subkey);
+        ok(!ret, "RegOpenKeyA %s failed with error %d\n", name, ret);
+        RegCloseKey(subkey);
+    }
+
+    ret = RegOpenKeyA(key, "Key500", &subkey);
+    ok(ret == ERROR_FILE_NOT_FOUND, "expected ERROR_FILE_NOT_FOUND, got %d\n", ret);
+
+    for (i = 0; i < 500; i += 2)
+    {
+        sprintf(name, "KEY%03u", i);
+        ret = RegDeleteKeyA(key, name);
+        ok(!ret, "RegDeleteKeyA %s failed with error %d\n", name, ret);
+    }
+
+    for (i = 0; i < 500; i++)
+    {
+        sprintf(name, "key%03u", i);
+        ret = RegOpenKeyA(key, name, &subkey);
+        if (i % 2) ok(!ret, "RegOpenKeyA %s failed with error %d\n", name, ret);
+        else ok(ret == ERROR_FILE_NOT_FOUND, "%s: expected ERROR_FILE_NOT_FOUND, got %d\n", name, ret);
+        if (!ret) RegCloseKey(subkey);
+    }
+
+    /* subkeys are still enumerated in order */
+    prev[0] = 0;
+    for (i = 0; ; i++)
+    {
+        size = sizeof(name);
+        ret = RegEnumKeyExA(key, i, name, &size, NULL, NULL, NULL, NULL);
+        if (ret) break;
+        ok(lstrcmpiA(prev, name) < 0, "%s enumerated after %s\n", name, prev);
+        strcpy(prev, name);
+    }
+    ok(ret == ERROR_NO_MORE_ITEMS, "RegEnumKeyExA failed with error %d\n", ret);
+    ok(i == 250, "expected 250 subkeys, got %u\n", i);
+
+    delete_key(key);
+    RegCloseKey(key);
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -3251,6 +3313,7 @@ START_TEST(registry)
     test_deleted_key();
     test_delete_value();
     test_delete_key_value();
+    test_many_subkeys();
 
     /* cleanup */
     delete_key( hkey_main );
@@ -21,8 +21,10 @@
 #include <assert.h>
 
 #include "gdi_private.h"
+#include "winreg.h"
 #include "dibdrv.h"
 
+#include "wine/unicode.h"
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(dib);
@@ -552,19 +554,152 @@ static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     }
 }
 
+/* Large rectangles can optionally be rendered in horizontal bands on the thread pool.
+ * Each band covers distinct destination rows, so the primitives don't need any locking. */
+
+#define MAX_RENDER_THREADS 16
+#define MIN_BAND_PIXELS    (256 * 1024)  /* minimum area for splitting a rectangle */
+#define MIN_BAND_HEIGHT    16
+
+struct render_params
+{
+    BOOL          (*func)( const struct render_params *params, const RECT *rect );
+    dib_info       *dst;
+    const dib_info *src;
+    RECT            rect;    /* full destination rectangle */
+    POINT           origin;  /* source origin of the full rectangle */
+    BLENDFUNCTION   blend;
+    const TRIVERTEX *vert;
+    int             mode;
+    const struct bitblt_coords *dst_coords;  /* stretch coordinates */
+    const struct bitblt_coords *src_coords;
+    struct stretch_params h_params;          /* horizontal stretch, the same for all bands */
+    BOOL            hstretch;
+    LONG            pending;
+    LONG            failed;
+    HANDLE          done;
+};
+
+struct render_band
+{
+    struct render_params *params;
+    RECT                  rect;
+};
+
+static unsigned int render_threads;
+
+static BOOL WINAPI init_render_threads( INIT_ONCE *once, void *param, void **context )
+{
+    static const WCHAR gdiW[] = {'S','o','f','t','w','a','r','e','\\','W','i','n','e','\\','G','d','i',0};
+    static const WCHAR render_threadsW[] = {'R','e','n','d','e','r','T','h','r','e','a','d','s',0};
+    WCHAR buffer[16];
+    DWORD type, size = sizeof(buffer) - sizeof(WCHAR);
+    HKEY hkey;
+    int count = 0;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\Gdi */
+    if (!RegOpenKeyW( HKEY_CURRENT_USER, gdiW, &hkey ))
+    {
+        if (!RegQueryValueExW( hkey, render_threadsW, NULL, &type, (BYTE *)buffer, &size ) && type == REG_SZ)
+        {
+            buffer[size / sizeof(WCHAR)] = 0;
+            count = atoiW( buffer );
+        }
+        RegCloseKey( hkey );
+    }
+    if (count > 1)
+    {
+        /* not bounded by the number of processors, so that the banded code gets exercised everywhere */
+        render_threads = min( count, MAX_RENDER_THREADS );
+        TRACE( "using %u render threads\n", render_threads );
+    }
+    return TRUE;
+}
+
+static int get_band_count( const RECT *rect )
+{
+    static INIT_ONCE init_once = INIT_ONCE_STATIC_INIT;
+    int height = rect->bottom - rect->top;
+
+    InitOnceExecuteOnce( &init_once, init_render_threads, NULL, NULL );
+    if (render_threads <= 1) return 1;
+    if ((rect->right - rect->left) * height < MIN_BAND_PIXELS) return 1;
+    return max( 1, min( render_threads, height / MIN_BAND_HEIGHT ));
+}
+
+static DWORD CALLBACK render_band_proc( void *arg )
+{
+    struct render_band *band = arg;
+    struct render_params *params = band->params;
+
+    if (!params->func( params, &band->rect )) InterlockedExchange( &params->failed, 1 );
+    if (!InterlockedDecrement( &params->pending )) SetEvent( params->done );
+    return 0;
+}
+
+static BOOL render_rect( struct render_params *params )
+{
+    struct render_band bands[MAX_RENDER_THREADS];
+    int i, count = get_band_count( &params->rect );
+    int height = params->rect.bottom - params->rect.top;
+
+    if (count > 1 && !(params->done = CreateEventW( NULL, TRUE, FALSE, NULL ))) count = 1;
+    if (count <= 1) return params->func( params, &params->rect );
+
+    params->pending = count;
+    params->failed = 0;
+    for (i = 0; i < count; i++)
+    {
+        bands[i].params = params;
+        bands[i].rect = params->rect;
+        bands[i].rect.top = params->rect.top + height * i / count;
+        bands[i].rect.bottom = params->rect.top + height * (i + 1) / count;
+    }
+    /* the first band is rendered by the calling thread */
+    for (i = 1; i < count; i++)
+        if (!QueueUserWorkItem( render_band_proc, &bands[i], WT_EXECUTEDEFAULT ))
+            render_band_proc( &bands[i] );
+    render_band_proc( &bands[0] );
+
+    WaitForSingleObject( params->done, INFINITE );
+    CloseHandle( params->done );
+    return !params->failed;
+}
+
+static BOOL render_blend_band( const struct render_params *params, const RECT *rect )
+{
+    POINT origin;
+
+    origin.x = params->origin.x + rect->left - params->rect.left;
+    origin.y = params->origin.y + rect->top  - params->rect.top;
+    params->dst->funcs->blend_rect( params->dst, rect, params->src, &origin, params->blend );
+    return TRUE;
+}
+
+static BOOL render_gradient_band( const struct render_params *params, const RECT *rect )
+{
+    return params->dst->funcs->gradient_rect( params->dst, rect, params->vert, params->mode );
+}
+
 static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                          HRGN clip, BLENDFUNCTION blend )
 {
-    POINT origin;
+    struct render_params params;
     struct clipped_rects clipped_rects;
     int i;
 
     if (!get_clipped_rects( dst, dst_rect, clip, &clipped_rects )) return ERROR_SUCCESS;
+
+    params.func  = render_blend_band;
+    params.dst   = dst;
+    params.src   = src;
+    params.blend = blend;
     for (i = 0; i < clipped_rects.count; i++)
     {
-        origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
-        origin.y = src_rect->top  + clipped_rects.rects[i].top  - dst_rect->top;
-        dst->funcs->blend_rect( dst, &clipped_rects.rects[i], src, &origin, blend );
+        params.rect = clipped_rects.rects[i];
+        params.origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
+        params.origin.y = src_rect->top  + clipped_rects.rects[i].top  - dst_rect->top;
+        render_rect( &params );
     }
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
@@ -653,12 +788,19 @@ static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, con
 {
     int i;
     struct clipped_rects clipped_rects;
+    struct render_params params;
     BOOL ret = TRUE;
 
     if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
+
+    params.func = render_gradient_band;
+    params.dst  = dib;
+    params.vert = v;
+    params.mode = mode;
     for (i = 0; i < clipped_rects.count; i++)
     {
-        if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
+        params.rect = clipped_rects.rects[i];
+        if (!(ret = render_rect( &params ))) break;
     }
     free_clipped_rects( &clipped_rects );
     return ret;
@@ -1145,63 +1287,310 @@ static DWORD calc_1d_stretch_params( INT dst_start, INT dst_length, INT dst_vis_
     return ERROR_SUCCESS;
 }
 
+/* Filtering for STRETCH_HALFTONE: bilinear, or an average of the covered source pixels
+ * when shrinking by more than half. The weights only depend on the extents and visible
+ * area of each axis, so the tables are cached for repeated blits. */
 
-DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
-                          const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
-                          INT mode )
+#define MAX_FILTER_TABLES 8
+#define FILTER_SHIFT      14  /* precision of the weights */
+
+struct filter_key
 {
-    dib_info src_dib, dst_dib;
-    POINT dst_start, src_start, dst_end, src_end;
-    RECT rect;
-    BOOL hstretch, vstretch;
-    struct stretch_params v_params, h_params;
-    int err;
-    DWORD ret;
-    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
-                    const dib_info *src_dib, const POINT *src_start,
-                    const struct stretch_params *params, int mode, BOOL keep_dst);
+    int dst_len, src_len;  /* full extents */
+    int dst_off, count;    /* visible part of the destination */
+    int src_min, src_max;  /* visible part of the source, relative to its origin */
+};
 
-    TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
-          dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
-          src->x, src->y, src->width, src->height, wine_dbgstr_rect(&src->visrect));
+struct filter_table
+{
+    struct list       entry;
+    LONG              refcount;
+    BOOL              cached;
+    struct filter_key key;
+    int               taps;    /* max number of source pixels for a destination pixel */
+    int              *index;   /* first source pixel for each destination pixel */
+    int              *count;   /* number of source pixels for each destination pixel */
+    WORD             *weight;  /* weights of the source pixels, 'taps' entries per destination pixel */
+};
 
-    init_dib_info_from_bitmapinfo( &src_dib, src_info, src_bits );
-    init_dib_info_from_bitmapinfo( &dst_dib, dst_info, dst_bits );
+static struct list filter_tables = LIST_INIT( filter_tables );
+static unsigned int filter_table_count;
 
-    /* v */
-    ret = calc_1d_stretch_params( dst->y, dst->height, dst->visrect.top, dst->visrect.bottom,
-                                  src->y, src->height, src->visrect.top, src->visrect.bottom,
-                                  &dst_start.y, &src_start.y, &dst_end.y, &src_end.y,
-                                  &v_params, &vstretch );
-    if (ret) return ret;
+static CRITICAL_SECTION filter_cs;
+static CRITICAL_SECTION_DEBUG filter_cs_debug =
+{
+    0, 0, &filter_cs,
+    { &filter_cs_debug.ProcessLocksList, &filter_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": filter_cs") }
+};
+static CRITICAL_SECTION filter_cs = { &filter_cs_debug, -1, 0, 0, 0, 0 };
 
-    /* h */
-    ret = calc_1d_stretch_params( dst->x, dst->width, dst->visrect.left, dst->visrect.right,
-                                  src->x, src->width, src->visrect.left, src->visrect.right,
-                                  &dst_start.x, &src_start.x, &dst_end.x, &src_end.x,
-                                  &h_params, &hstretch );
-    if (ret) return ret;
+/* weights of the source pixels covered by [start,end), in 16.16 fixed point */
+static int get_box_weights( WORD *weight, LONGLONG start, LONGLONG end, int index )
+{
+    LONGLONG pos, cover;
+    int i, count = ((end + 0xffff) >> 16) - index, total = 0;
 
-    TRACE("got dst start %d, %d inc %d, %d. src start %d, %d inc %d, %d len %d x %d\n",
-          dst_start.x, dst_start.y, h_params.dst_inc, v_params.dst_inc,
-          src_start.x, src_start.y, h_params.src_inc, v_params.src_inc,
-          h_params.length, v_params.length);
+    for (i = 0; i < count; i++)
+    {
+        pos = (LONGLONG)(index + i) << 16;
+        cover = min( end, pos + 0x10000 ) - max( start, pos );
+        weight[i] = cover * (1 << FILTER_SHIFT) / (end - start);
+        total += weight[i];
+    }
+    weight[0] += (1 << FILTER_SHIFT) - total;  /* rounding errors */
+    return count;
+}
 
-    get_bounding_rect( &rect, dst_start.x, dst_start.y, dst_end.x - dst_start.x, dst_end.y - dst_start.y );
-    intersect_rect( &dst->visrect, &dst->visrect, &rect );
+static struct filter_table *create_filter_table( const struct filter_key *key )
+{
+    struct filter_table *table;
+    BOOL box = key->src_len > 2 * key->dst_len;
+    int i, taps = box ? key->src_len / key->dst_len + 2 : 2;
+    LONGLONG pos, end, src_start = (LONGLONG)key->src_min << 16, src_end = (LONGLONG)(key->src_max + 1) << 16;
+
+    if (!(table = HeapAlloc( GetProcessHeap(), 0, sizeof(*table) +
+                             key->count * (2 * sizeof(int) + taps * sizeof(WORD)) )))
+        return NULL;
+    table->refcount = 1;
+    table->cached = FALSE;
+    table->key = *key;
+    table->taps = taps;
+    table->index = (int *)(table + 1);
+    table->count = table->index + key->count;
+    table->weight = (WORD *)(table->count + key->count);
+
+    for (i = 0; i < key->count; i++)
+    {
+        WORD *weight = table->weight + i * taps;
 
-    dst_start.x -= dst->visrect.left;
+        if (box)
+        {
+            /* area covered by the destination pixel */
+            pos = (LONGLONG)(key->dst_off + i) * key->src_len * 0x10000 / key->dst_len;
+            end = (LONGLONG)(key->dst_off + i + 1) * key->src_len * 0x10000 / key->dst_len;
+            pos = max( pos, src_start );
+            end = min( end, src_end );
+        }
+        else
+        {
+            /* map pixel centers */
+            pos = (LONGLONG)(2 * (key->dst_off + i) + 1) * key->src_len * 0x10000 / (2 * key->dst_len) - 0x8000;
+            pos = max( pos, src_start );
+            end = pos + 0x10000;
+        }
+
+        if (pos >= src_end - 0x10000 || (box && end <= pos))
+        {
+            table->index[i] = pos < src_end ? pos >> 16 : key->src_max;
+            table->count[i] = 1;
+            weight[0] = 1 << FILTER_SHIFT;
+        }
+        else if (box)
+        {
+            table->index[i] = pos >> 16;
+            table->count[i] = get_box_weights( weight, pos, end, table->index[i] );
+        }
+        else
+        {
+            table->index[i] = pos >> 16;
+            weight[1] = (pos >> (16 - FILTER_SHIFT)) & ((1 << FILTER_SHIFT) - 1);
+            weight[0] = (1 << FILTER_SHIFT) - weight[1];
+            table->count[i] = weight[1] ? 2 : 1;
+        }
+    }
+    return table;
+}
+
+static void release_filter_table( struct filter_table *table )
+{
+    BOOL free_it;
+
+    EnterCriticalSection( &filter_cs );
+    free_it = !--table->refcount && !table->cached;
+    LeaveCriticalSection( &filter_cs );
+    if (free_it) HeapFree( GetProcessHeap(), 0, table );
+}
+
+static struct filter_table *get_filter_table( const struct filter_key *key )
+{
+    struct filter_table *table;
+
+    EnterCriticalSection( &filter_cs );
+    LIST_FOR_EACH_ENTRY( table, &filter_tables, struct filter_table, entry )
+    {
+        if (memcmp( &table->key, key, sizeof(*key) )) continue;
+        list_remove( &table->entry );
+        list_add_head( &filter_tables, &table->entry );
+        table->refcount++;
+        LeaveCriticalSection( &filter_cs );
+        return table;
+    }
+    LeaveCriticalSection( &filter_cs );
+
+    if (!(table = create_filter_table( key ))) return NULL;
+
+    EnterCriticalSection( &filter_cs );
+    if (filter_table_count == MAX_FILTER_TABLES)
+    {
+        struct filter_table *old = LIST_ENTRY( list_tail( &filter_tables ), struct filter_table, entry );
+
+        list_remove( &old->entry );
+        old->cached = FALSE;
+        if (!old->refcount) HeapFree( GetProcessHeap(), 0, old );
+    }
+    else filter_table_count++;
+    table->cached = TRUE;
+    list_add_head( &filter_tables, &table->entry );
+    LeaveCriticalSection( &filter_cs );
+    return table;
+}
+
+/* horizontal pass, the result has 8 bits of extra precision */
+static void filter_row( WORD *dst, const BYTE *src, const struct filter_table *table, int bpp )
+{
+    int i, j, k;
+
+    for (i = 0; i < table->key.count; i++, dst += bpp)
+    {
+        const BYTE *ptr = src + table->index[i] * bpp;
+        const WORD *weight = table->weight + i * table->taps;
+        DWORD sum[4] = { 0, 0, 0, 0 };
+
+        for (k = 0; k < table->count[i]; k++, ptr += bpp)
+            for (j = 0; j < bpp; j++) sum[j] += ptr[j] * weight[k];
+        for (j = 0; j < bpp; j++) dst[j] = (sum[j] + (1 << (FILTER_SHIFT - 9))) >> (FILTER_SHIFT - 8);
+    }
+}
+
+/* vertical pass, simple enough to be vectorized by the compiler */
+static void filter_column( DWORD *sum, const WORD *row, int len, int weight )
+{
+    int i;
+
+    for (i = 0; i < len; i++) sum[i] += row[i] * weight;
+}
+
+static BOOL stretch_halftone( const dib_info *dst_dib, const struct bitblt_coords *dst,
+                              const dib_info *src_dib, const struct bitblt_coords *src )
+{
+    struct filter_key key_x, key_y;
+    struct filter_table *table_x, *table_y = NULL;
+    int bpp = dst_dib->bit_count / 8;
+    int i, k, y, len, last = 1, row_y[2] = { -1, -1 };
+    DWORD *sum;
+    WORD *rows[2];
+    const BYTE *src_ptr;
+    BYTE *dst_ptr;
+
+    if (dst->width <= 0 || dst->height <= 0 || src->width <= 0 || src->height <= 0) return FALSE;
+    if (is_rect_empty( &dst->visrect ) || is_rect_empty( &src->visrect )) return FALSE;
+
+    /* only formats with 8-bit byte-aligned channels */
+    switch (dst_dib->bit_count)
+    {
+    case 24:
+        break;
+    case 32:
+        if (dst_dib->red_len != 8 || dst_dib->green_len != 8 || dst_dib->blue_len != 8) return FALSE;
+        if ((dst_dib->red_shift | dst_dib->green_shift | dst_dib->blue_shift) & 7) return FALSE;
+        break;
+    default:
+        return FALSE;
+    }
+
+    key_x.dst_len = dst->width;
+    key_x.src_len = src->width;
+    key_x.dst_off = dst->visrect.left - dst->x;
+    key_x.count   = dst->visrect.right - dst->visrect.left;
+    key_x.src_min = src->visrect.left - src->x;
+    key_x.src_max = src->visrect.right - 1 - src->x;
+    key_y.dst_len = dst->height;
+    key_y.src_len = src->height;
+    key_y.dst_off = dst->visrect.top - dst->y;
+    key_y.count   = dst->visrect.bottom - dst->visrect.top;
+    key_y.src_min = src->visrect.top - src->y;
+    key_y.src_max = src->visrect.bottom - 1 - src->y;
+
+    len = key_x.count * bpp;
+    if (!(sum = HeapAlloc( GetProcessHeap(), 0, len * (sizeof(DWORD) + 2 * sizeof(WORD)) ))) return FALSE;
+    rows[0] = (WORD *)(sum + len);
+    rows[1] = rows[0] + len;
+
+    if (!(table_x = get_filter_table( &key_x )) || !(table_y = get_filter_table( &key_y )))
+    {
+        if (table_x) release_filter_table( table_x );
+        HeapFree( GetProcessHeap(), 0, sum );
+        return FALSE;
+    }
+
+    src_ptr = (const BYTE *)src_dib->bits.ptr + (src_dib->rect.left + src->x) * bpp;
+    dst_ptr = (BYTE *)dst_dib->bits.ptr + dst_dib->rect.top * dst_dib->stride + dst_dib->rect.left * bpp;
+
+    for (y = 0; y < key_y.count; y++, dst_ptr += dst_dib->stride)
+    {
+        const WORD *weight = table_y->weight + y * table_y->taps;
+
+        memset( sum, 0, len * sizeof(*sum) );
+        for (k = 0; k < table_y->count[y]; k++)
+        {
+            /* consecutive destination rows share at most two filtered source rows */
+            int sy = table_y->index[y] + k, slot;
+
+            if (row_y[0] == sy) slot = 0;
+            else if (row_y[1] == sy) slot = 1;
+            else
+            {
+                slot = !last;
+                filter_row( rows[slot], src_ptr + (src_dib->rect.top + src->y + sy) * src_dib->stride,
+                            table_x, bpp );
+                row_y[slot] = sy;
+            }
+            last = slot;
+            filter_column( sum, rows[slot], len, weight[k] );
+        }
+        for (i = 0; i < len; i++) dst_ptr[i] = (sum[i] + (1 << (FILTER_SHIFT + 7))) >> (FILTER_SHIFT + 8);
+    }
+
+    release_filter_table( table_x );
+    release_filter_table( table_y );
+    HeapFree( GetProcessHeap(), 0, sum );
+    return TRUE;
+}
+
+/* stretch the destination rows of a band, the horizontal parameters are precomputed */
+static BOOL render_stretch_band( const struct render_params *params, const RECT *rect )
+{
+    const struct bitblt_coords *dst = params->dst_coords, *src = params->src_coords;
+    dib_info *dst_dib = params->dst;
+    const dib_info *src_dib = params->src;
+    POINT dst_start, src_start, dst_end, src_end;
+    BOOL vstretch;
+    struct stretch_params v_params;
+    int err, mode = params->mode;
+    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
+                    const dib_info *src_dib, const POINT *src_start,
+                    const struct stretch_params *params, int mode, BOOL keep_dst);
+
+    if (calc_1d_stretch_params( dst->y, dst->height, rect->top, rect->bottom,
+                                src->y, src->height, src->visrect.top, src->visrect.bottom,
+                                &dst_start.y, &src_start.y, &dst_end.y, &src_end.y,
+                                &v_params, &vstretch ))
+        return TRUE;
+
+    dst_start.x = params->origin.x - dst->visrect.left;
     dst_start.y -= dst->visrect.top;
+    src_start.x = params->origin.y;
 
     err = v_params.err_start;
 
-    row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+    row_fn = params->hstretch ? dst_dib->funcs->stretch_row : dst_dib->funcs->shrink_row;
 
     if (vstretch)
     {
         BOOL need_row = TRUE;
         RECT last_row, this_row;
-        if (hstretch) mode = STRETCH_DELETESCANS;
+        if (params->hstretch) mode = STRETCH_DELETESCANS;
         last_row.left = 0;
         last_row.right = dst->visrect.right - dst->visrect.left;
 
@@ -1209,7 +1598,7 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
         {
             if (need_row)
             {
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, FALSE );
+                row_fn( dst_dib, &dst_start, src_dib, &src_start, &params->h_params, mode, FALSE );
                 need_row = FALSE;
             }
             else
@@ -1218,7 +1607,7 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
                 last_row.bottom = last_row.top + 1;
                 this_row = last_row;
                 offset_rect( &this_row, 0, v_params.dst_inc );
-                copy_rect( &dst_dib, &this_row, &dst_dib, &last_row, NULL, R2_COPYPEN );
+                copy_rect( dst_dib, &this_row, dst_dib, &last_row, NULL, R2_COPYPEN );
             }
 
             if (err > 0)
@@ -1238,7 +1627,7 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
         while (v_params.length--)
         {
             if (mode != STRETCH_DELETESCANS || !merged_rows)
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, merged_rows != 0 );
+                row_fn( dst_dib, &dst_start, src_dib, &src_start, &params->h_params, mode, merged_rows != 0 );
             merged_rows++;
 
             if (err > 0)
@@ -1251,7 +1640,66 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
             src_start.y += v_params.src_inc;
         }
     }
+    return TRUE;
+}
+
+DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
+                          const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
+                          INT mode )
+{
+    dib_info src_dib, dst_dib;
+    POINT dst_start, src_start, dst_end, src_end;
+    RECT rect;
+    BOOL hstretch, vstretch;
+    struct stretch_params v_params, h_params;
+    struct render_params params;
+    DWORD ret;
+
+    TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
+          dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
+          src->x, src->y, src->width, src->height, wine_dbgstr_rect(&src->visrect));
+
+    init_dib_info_from_bitmapinfo( &src_dib, src_info, src_bits );
+    init_dib_info_from_bitmapinfo( &dst_dib, dst_info, dst_bits );
+
+    /* v */
+    ret = calc_1d_stretch_params( dst->y, dst->height, dst->visrect.top, dst->visrect.bottom,
+                                  src->y, src->height, src->visrect.top, src->visrect.bottom,
+                                  &dst_start.y, &src_start.y, &dst_end.y, &src_end.y,
+                                  &v_params, &vstretch );
+    if (ret) return ret;
+
+    /* h */
+    ret = calc_1d_stretch_params( dst->x, dst->width, dst->visrect.left, dst->visrect.right,
+                                  src->x, src->width, src->visrect.left, src->visrect.right,
+                                  &dst_start.x, &src_start.x, &dst_end.x, &src_end.x,
+                                  &h_params, &hstretch );
+    if (ret) return ret;
+
+    TRACE("got dst start %d, %d inc %d, %d. src start %d, %d inc %d, %d len %d x %d\n",
+          dst_start.x, dst_start.y, h_params.dst_inc, v_params.dst_inc,
+          src_start.x, src_start.y, h_params.src_inc, v_params.src_inc,
+          h_params.length, v_params.length);
+
+    get_bounding_rect( &rect, dst_start.x, dst_start.y, dst_end.x - dst_start.x, dst_end.y - dst_start.y );
+    intersect_rect( &dst->visrect, &dst->visrect, &rect );
 
+    if (mode == STRETCH_HALFTONE && stretch_halftone( &dst_dib, dst, &src_dib, src )) goto done;
+
+    params.func       = render_stretch_band;
+    params.dst        = &dst_dib;
+    params.src        = &src_dib;
+    params.rect       = dst->visrect;
+    params.origin.x   = dst_start.x;  /* horizontal start, the same for all bands */
+    params.origin.y   = src_start.x;
+    params.mode       = mode;
+    params.dst_coords = dst;
+    params.src_coords = src;
+    params.h_params   = h_params;
+    params.hstretch   = hstretch;
+    render_rect( &params );
+
+done:
     /* update coordinates, the destination rectangle is always stored at 0,0 */
     *src = *dst;
     src->x -= src->visrect.left;
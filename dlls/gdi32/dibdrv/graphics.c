@@ -43,10 +43,16 @@ enum glyph_type
 #define GLYPH_CACHE_PAGE_SIZE  0x100
 #define GLYPH_CACHE_PAGES      (0x10000 / GLYPH_CACHE_PAGE_SIZE)
 
+#define FONT_CACHE_BUCKETS     64
+#define MAX_UNUSED_FONTS       32                /* unused fonts kept around */
+#define MAX_GLYPH_CACHE_SIZE   (8 * 1024 * 1024) /* memory used by glyphs of unused fonts */
+
 struct cached_font
 {
-    struct list           entry;
+    struct list           entry;         /* entry in the LRU list */
+    struct list           bucket_entry;  /* entry in the hash bucket */
     LONG                  ref;
+    LONG                  glyph_size;    /* memory used by the cached glyphs */
     DWORD                 hash;
     LOGFONTW              lf;
     XFORM                 xform;
@@ -55,6 +61,7 @@ struct cached_font
 };
 
 static struct list font_cache = LIST_INIT( font_cache );
+static struct list font_cache_buckets[FONT_CACHE_BUCKETS];
 
 static CRITICAL_SECTION font_cache_cs;
 static CRITICAL_SECTION_DEBUG critsect_debug =
@@ -482,10 +489,58 @@ static int font_cache_cmp( const struct cached_font *p1, const struct cached_fon
     return ret;
 }
 
+static void free_cached_font( struct cached_font *font )
+{
+    UINT i, j, k;
+
+    for (i = 0; i < GLYPH_NBTYPES; i++)
+    {
+        for (j = 0; j < GLYPH_CACHE_PAGES; j++)
+        {
+            if (!font->glyphs[i][j]) continue;
+            for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
+                HeapFree( GetProcessHeap(), 0, font->glyphs[i][j][k] );
+            HeapFree( GetProcessHeap(), 0, font->glyphs[i][j] );
+        }
+    }
+    list_remove( &font->entry );
+    list_remove( &font->bucket_entry );
+    HeapFree( GetProcessHeap(), 0, font );
+}
+
+/* free the least recently used fonts that are no longer selected anywhere; glyphs of
+ * fonts in use can't be freed since they are accessed without locking, so only the
+ * glyphs of unused fonts count towards the limit.
+ * must be called with the font_cache_cs held, which is needed to reference a font again */
+static void trim_font_cache(void)
+{
+    struct cached_font *font, *next;
+    LONG total = 0;
+    UINT unused = 0;
+
+    LIST_FOR_EACH_ENTRY( font, &font_cache, struct cached_font, entry )
+    {
+        if (font->ref) continue;
+        total += font->glyph_size;
+        unused++;
+    }
+
+    LIST_FOR_EACH_ENTRY_SAFE_REV( font, next, &font_cache, struct cached_font, entry )
+    {
+        if (unused <= MAX_UNUSED_FONTS && total <= MAX_GLYPH_CACHE_SIZE) break;
+        if (font->ref) continue;
+        TRACE( "freeing %p, %d bytes of glyphs\n", font, font->glyph_size );
+        total -= font->glyph_size;
+        unused--;
+        free_cached_font( font );
+    }
+}
+
 static struct cached_font *add_cached_font( HDC hdc, HFONT hfont, UINT aa_flags )
 {
-    struct cached_font font, *ptr, *last_unused = NULL;
-    UINT i = 0, j, k;
+    struct cached_font font, *ptr;
+    struct list *bucket;
+    UINT i;
 
     GetObjectW( hfont, sizeof(font.lf), &font.lf );
     GetTransform( hdc, 0x204, &font.xform );
@@ -501,7 +556,11 @@ static struct cached_font *add_cached_font( HDC hdc, HFONT hfont, UINT aa_flags
     font.hash = font_cache_hash( &font );
 
     EnterCriticalSection( &font_cache_cs );
-    LIST_FOR_EACH_ENTRY( ptr, &font_cache, struct cached_font, entry )
+    if (!font_cache_buckets[0].next)
+        for (i = 0; i < FONT_CACHE_BUCKETS; i++) list_init( &font_cache_buckets[i] );
+
+    bucket = &font_cache_buckets[font.hash % FONT_CACHE_BUCKETS];
+    LIST_FOR_EACH_ENTRY( ptr, bucket, struct cached_font, bucket_entry )
     {
         if (!font_cache_cmp( &font, ptr ))
         {
@@ -509,29 +568,10 @@ static struct cached_font *add_cached_font( HDC hdc, HFONT hfont, UINT aa_flags
             list_remove( &ptr->entry );
             goto done;
         }
-        if (!ptr->ref)
-        {
-            i++;
-            last_unused = ptr;
-        }
     }
 
-    if (i > 5)  /* keep at least 5 of the most-recently used fonts around */
-    {
-        ptr = last_unused;
-        for (i = 0; i < GLYPH_NBTYPES; i++)
-        {
-            for (j = 0; j < GLYPH_CACHE_PAGES; j++)
-            {
-                if (!ptr->glyphs[i][j]) continue;
-                for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
-                    HeapFree( GetProcessHeap(), 0, ptr->glyphs[i][j][k] );
-                HeapFree( GetProcessHeap(), 0, ptr->glyphs[i][j] );
-            }
-        }
-        list_remove( &ptr->entry );
-    }
-    else if (!(ptr = HeapAlloc( GetProcessHeap(), 0, sizeof(*ptr) )))
+    trim_font_cache();
+    if (!(ptr = HeapAlloc( GetProcessHeap(), 0, sizeof(*ptr) )))
     {
         LeaveCriticalSection( &font_cache_cs );
         return NULL;
@@ -539,7 +579,9 @@ static struct cached_font *add_cached_font( HDC hdc, HFONT hfont, UINT aa_flags
 
     *ptr = font;
     ptr->ref = 1;
+    ptr->glyph_size = 0;
     memset( ptr->glyphs, 0, sizeof(ptr->glyphs) );
+    list_add_head( bucket, &ptr->bucket_entry );
 done:
     list_add_head( &font_cache, &ptr->entry );
     LeaveCriticalSection( &font_cache_cs );
@@ -553,7 +595,7 @@ void release_cached_font( struct cached_font *font )
 }
 
 static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT index, UINT flags,
-                                              struct cached_glyph *glyph )
+                                              struct cached_glyph *glyph, DWORD size )
 {
     struct cached_glyph *ret;
     enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
@@ -574,7 +616,11 @@ static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT ind
             HeapFree( GetProcessHeap(), 0, ptr );
     }
     ret = InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page][entry], glyph, NULL );
-    if (!ret) ret = glyph;
+    if (!ret)
+    {
+        InterlockedExchangeAdd( &font->glyph_size, size );
+        ret = glyph;
+    }
     else HeapFree( GetProcessHeap(), 0, glyph );
     return ret;
 }
@@ -733,7 +779,7 @@ static struct cached_glyph *cache_glyph_bitmap( HDC hdc, struct cached_font *fon
 
 done:
     glyph->metrics = metrics;
-    return add_cached_glyph( font, index, flags, glyph );
+    return add_cached_glyph( font, index, flags, glyph, FIELD_OFFSET( struct cached_glyph, bits[size] ));
 }
 
 static void render_string( HDC hdc, dib_info *dib, struct cached_font *font, INT x, INT y,
@@ -19,6 +19,12 @@
  */
 
 #include <assert.h>
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_SSE2_BLEND
+#include <emmintrin.h>
+#define SSE2_TARGET __attribute__((target("sse2")))
+#endif
 
 #include "gdi_private.h"
 #include "dibdrv.h"
@@ -4182,32 +4188,138 @@ static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BL
             blend_color( dst_r, src >> 16, blend.SourceConstantAlpha ) << 16);
 }
 
+#ifdef HAVE_SSE2_BLEND
+
+/* (x + 127) / 255 on 16-bit lanes, exact for x <= 255 * 255 */
+static inline SSE2_TARGET __m128i div255_epu16( __m128i x )
+{
+    x = _mm_add_epi16( x, _mm_set1_epi16( 127 ));
+    return _mm_srli_epi16( _mm_mulhi_epu16( x, _mm_set1_epi16( 0x8081 )), 7 );
+}
+
+/* same as blend_argb() on two pixels unpacked to 16-bit lanes */
+static inline SSE2_TARGET __m128i blend_argb_epi16( __m128i dst, __m128i src )
+{
+    __m128i inv_alpha = _mm_xor_si128( src, _mm_set1_epi16( 0xff ));
+
+    inv_alpha = _mm_shufflehi_epi16( _mm_shufflelo_epi16( inv_alpha, 0xff ), 0xff );
+    return _mm_add_epi16( src, div255_epu16( _mm_mullo_epi16( dst, inv_alpha )));
+}
+
+static SSE2_TARGET void blend_row_argb_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16( 255 );
+    const __m128i const_alpha = _mm_set1_epi16( alpha );
+    int x, i;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        __m128i s_lo = _mm_unpacklo_epi8( s, zero );
+        __m128i s_hi = _mm_unpackhi_epi8( s, zero );
+        __m128i lo, hi;
+
+        if (alpha != 255)
+        {
+            s_lo = div255_epu16( _mm_mullo_epi16( s_lo, const_alpha ));
+            s_hi = div255_epu16( _mm_mullo_epi16( s_hi, const_alpha ));
+        }
+        lo = blend_argb_epi16( _mm_unpacklo_epi8( d, zero ), s_lo );
+        hi = blend_argb_epi16( _mm_unpackhi_epi8( d, zero ), s_hi );
+
+        /* channels of a source that isn't premultiplied can overflow into the next
+         * one, leave those to the scalar code to get the exact same result */
+        if (_mm_movemask_epi8( _mm_or_si128( _mm_cmpgt_epi16( lo, max ), _mm_cmpgt_epi16( hi, max ))))
+        {
+            for (i = x; i < x + 4; i++)
+                dst[i] = alpha == 255 ? blend_argb( dst[i], src[i] ) : blend_argb_alpha( dst[i], src[i], alpha );
+            continue;
+        }
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_packus_epi16( lo, hi ));
+    }
+    for ( ; x < len; x++)
+        dst[x] = alpha == 255 ? blend_argb( dst[x], src[x] ) : blend_argb_alpha( dst[x], src[x], alpha );
+}
+
+/* same as blend_argb_constant_alpha(), or blend_argb_no_src_alpha() when src_mask is 0xff000000 */
+static SSE2_TARGET void blend_row_constant_alpha_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha, DWORD src_mask )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi32( src_mask );
+    const __m128i const_alpha = _mm_set1_epi16( alpha );
+    const __m128i inv_alpha = _mm_set1_epi16( 255 - alpha );
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_or_si128( _mm_loadu_si128( (const __m128i *)(src + x) ), mask );
+        __m128i d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        __m128i lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( s, zero ), const_alpha ),
+                                    _mm_mullo_epi16( _mm_unpacklo_epi8( d, zero ), inv_alpha ));
+        __m128i hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( s, zero ), const_alpha ),
+                                    _mm_mullo_epi16( _mm_unpackhi_epi8( d, zero ), inv_alpha ));
+
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_packus_epi16( div255_epu16( lo ), div255_epu16( hi )));
+    }
+    for ( ; x < len; x++)
+        dst[x] = blend_argb_constant_alpha( dst[x], src[x] | src_mask, alpha );
+}
+
+#endif  /* HAVE_SSE2_BLEND */
+
+static void blend_row_argb( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    int x;
+
+    if (alpha == 255)
+        for (x = 0; x < len; x++) dst[x] = blend_argb( dst[x], src[x] );
+    else
+        for (x = 0; x < len; x++) dst[x] = blend_argb_alpha( dst[x], src[x], alpha );
+}
+
+static void blend_row_constant_alpha( DWORD *dst, const DWORD *src, int len, DWORD alpha, DWORD src_mask )
+{
+    int x;
+
+    if (src_mask)
+        for (x = 0; x < len; x++) dst[x] = blend_argb_no_src_alpha( dst[x], src[x], alpha );
+    else
+        for (x = 0; x < len; x++) dst[x] = blend_argb_constant_alpha( dst[x], src[x], alpha );
+}
+
+static void (*blend_row_argb_func)( DWORD *dst, const DWORD *src, int len, DWORD alpha ) = blend_row_argb;
+static void (*blend_row_constant_alpha_func)( DWORD *dst, const DWORD *src, int len, DWORD alpha,
+                                              DWORD src_mask ) = blend_row_constant_alpha;
+
+/* called on process attach, before any other thread can use the functions */
+void init_dib_primitives(void)
+{
+#ifdef HAVE_SSE2_BLEND
+    /* SSE2 is part of the x86_64 baseline, but not of the i386 one */
+    if (IsProcessorFeaturePresent( PF_XMMI64_INSTRUCTIONS_AVAILABLE ))
+    {
+        blend_row_argb_func = blend_row_argb_sse2;
+        blend_row_constant_alpha_func = blend_row_constant_alpha_sse2;
+    }
+#endif
+}
+
 static void blend_rect_8888(const dib_info *dst, const RECT *rc,
                             const dib_info *src, const POINT *origin, BLENDFUNCTION blend)
 {
     DWORD *src_ptr = get_pixel_ptr_32( src, origin->x, origin->y );
     DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
-    int x, y;
+    int y;
 
     if (blend.AlphaFormat & AC_SRC_ALPHA)
-    {
-	if (blend.SourceConstantAlpha == 255)
-	    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-		for (x = 0; x < rc->right - rc->left; x++)
-		    dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
-        else
-	    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-		for (x = 0; x < rc->right - rc->left; x++)
-		    dst_ptr[x] = blend_argb_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
-    }
-    else if (src->compression == BI_RGB)
-	for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-	    for (x = 0; x < rc->right - rc->left; x++)
-		dst_ptr[x] = blend_argb_constant_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+        for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+            blend_row_argb_func( dst_ptr, src_ptr, rc->right - rc->left, blend.SourceConstantAlpha );
     else
-	for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-	    for (x = 0; x < rc->right - rc->left; x++)
-		dst_ptr[x] = blend_argb_no_src_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+        for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+            blend_row_constant_alpha_func( dst_ptr, src_ptr, rc->right - rc->left, blend.SourceConstantAlpha,
+                                           src->compression == BI_RGB ? 0 : 0xff000000 );
 }
 
 static void blend_rect_32(const dib_info *dst, const RECT *rc,
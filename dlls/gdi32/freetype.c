@@ -473,6 +473,7 @@ typedef struct tagFontSubst {
 static const WCHAR wine_fonts_key[] = {'S','o','f','t','w','a','r','e','\\','W','i','n','e','\\',
                                        'F','o','n','t','s',0};
 static const WCHAR wine_fonts_cache_key[] = {'C','a','c','h','e',0};
+static const WCHAR wine_fonts_index_key[] = {'I','n','d','e','x',0};
 static const WCHAR english_name_value[] = {'E','n','g','l','i','s','h',' ','N','a','m','e',0};
 static const WCHAR face_index_value[] = {'I','n','d','e','x',0};
 static const WCHAR face_ntmflags_value[] = {'N','t','m','f','l','a','g','s',0};
@@ -504,6 +505,50 @@ static struct list mappings_list = LIST_INIT( mappings_list );
 static UINT default_aa_flags;
 static HKEY hkey_font_cache;
 
+/* Persistent index of the faces found in each font file, so that the font files
+ * don't need to be opened again when the volatile cache has to be rebuilt. */
+
+#define FONT_INDEX_VERSION 2
+
+struct font_index_stamp
+{
+    ULONGLONG size;
+    LONGLONG  mtime;
+};
+
+struct font_index_face
+{
+    DWORD         size;         /* size of the whole record, including the strings and padding */
+    DWORD         flags;        /* ADDFONT_VERTICAL_FONT */
+    DWORD         face_index;
+    DWORD         ntm_flags;
+    DWORD         font_version;
+    FONTSIGNATURE fs;
+    DWORD         scalable;
+    DWORD         height;
+    DWORD         width;
+    DWORD         bitmap_size;
+    DWORD         x_ppem;
+    DWORD         y_ppem;
+    DWORD         internal_leading;
+    WORD          name_len[4];  /* family, english, style and full names, including the null, 0 if absent */
+    /* WCHAR names[] */
+};
+
+struct font_index_file
+{
+    HKEY  hkey;
+    int   count;      /* number of faces */
+    BOOL  nested;     /* fonts were loaded from other files, e.g. expanded Mac fonts */
+    BYTE *data;       /* packed font_index_face records */
+    DWORD data_size;
+    DWORD data_len;
+};
+
+static HKEY hkey_font_index;
+static DWORD font_index_generation;
+static struct font_index_file *font_index_file;  /* file currently being loaded */
+
 static CRITICAL_SECTION freetype_cs;
 static CRITICAL_SECTION_DEBUG critsect_debug =
 {
@@ -1824,14 +1869,11 @@ static void get_family_names( FT_Face ft_face, WCHAR **name, WCHAR **english, BO
     }
 }
 
-static Family *get_family( FT_Face ft_face, BOOL vertical )
+/* NB This function takes ownership of the names */
+static Family *get_family_from_names( WCHAR *name, WCHAR *english_name )
 {
-    Family *family;
-    WCHAR *name, *english_name;
+    Family *family = find_family_from_name( name );
 
-    get_family_names( ft_face, &name, &english_name, vertical );
-
-    family = find_family_from_name( name );
 
     if (!family)
     {
@@ -1856,6 +1898,14 @@ static Family *get_family( FT_Face ft_face, BOOL vertical )
     return family;
 }
 
+static Family *get_family( FT_Face ft_face, BOOL vertical )
+{
+    WCHAR *name, *english_name;
+
+    get_family_names( ft_face, &name, &english_name, vertical );
+    return get_family_from_names( name, english_name );
+}
+
 static inline FT_Fixed get_font_version( FT_Face ft_face )
 {
     FT_Fixed version = 0;
@@ -2032,6 +2082,316 @@ static Face *create_face( FT_Face ft_face, FT_Long face_index, const char *file,
     return face;
 }
 
+/* insert the face in the family, and release both */
+static void add_face_to_family( Face *face, Family *family, DWORD flags )
+{
+    if (insert_face_in_family_list( face, family ))
+    {
+        if (flags & ADDFONT_ADD_TO_CACHE)
+            add_face_to_cache( face );
+
+        TRACE("Added font %s %s\n", debugstr_w(family->FamilyName),
+              debugstr_w(face->StyleName));
+    }
+    release_face( face );
+    release_family( family );
+}
+
+static const WCHAR index_version_value[] = {'V','e','r','s','i','o','n',0};
+static const WCHAR index_language_value[] = {'L','a','n','g','u','a','g','e',0};
+static const WCHAR index_generation_value[] = {'G','e','n','e','r','a','t','i','o','n',0};
+static const WCHAR index_freetype_value[] = {'F','r','e','e','T','y','p','e',0};
+static const char index_build_value[] = "Build";
+/* bitmap fonts are only loaded with ADDFONT_ALLOW_BITMAP, so each mode has its own entry */
+static const WCHAR index_stamp_value[2][13] = {{'S','t','a','m','p',0},
+                                               {'B','i','t','m','a','p',' ','S','t','a','m','p',0}};
+static const WCHAR index_faces_value[2][13] = {{'F','a','c','e','s',0},
+                                               {'B','i','t','m','a','p',' ','F','a','c','e','s',0}};
+
+/* faces are parsed differently by other FreeType or Wine versions */
+static BOOL font_index_build_matches( HKEY hkey )
+{
+    const char *build = wine_get_build_id();
+    char buffer[256];
+    DWORD type, size = sizeof(buffer), freetype;
+
+    if (reg_load_dword( hkey, index_freetype_value, &freetype ) || freetype != FT_SimpleVersion)
+        return FALSE;
+    if (RegQueryValueExA( hkey, index_build_value, NULL, &type, (BYTE *)buffer, &size ) ||
+        type != REG_SZ || size != strlen( build ) + 1)
+        return FALSE;
+    return !memcmp( buffer, build, size );
+}
+
+static void open_font_index(void)
+{
+    HKEY hkey_wine_fonts;
+    DWORD version, language, generation;
+    const char *build = wine_get_build_id();
+
+    if (RegOpenKeyExW( HKEY_CURRENT_USER, wine_fonts_key, 0, KEY_ALL_ACCESS, &hkey_wine_fonts )) return;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\Fonts\Index */
+    if (!RegCreateKeyExW( hkey_wine_fonts, wine_fonts_index_key, 0, NULL, 0, KEY_ALL_ACCESS, NULL,
+                          &hkey_font_index, NULL ))
+    {
+        /* face and family names are localized, so the index depends on the language too */
+        if (reg_load_dword( hkey_font_index, index_version_value, &version ) ||
+            reg_load_dword( hkey_font_index, index_language_value, &language ) ||
+            version != FONT_INDEX_VERSION || language != GetSystemDefaultLangID() ||
+            !font_index_build_matches( hkey_font_index ))
+        {
+            TRACE( "rebuilding font index\n" );
+            RegCloseKey( hkey_font_index );
+            RegDeleteTreeW( hkey_wine_fonts, wine_fonts_index_key );
+            hkey_font_index = 0;
+            if (!RegCreateKeyExW( hkey_wine_fonts, wine_fonts_index_key, 0, NULL, 0, KEY_ALL_ACCESS, NULL,
+                                  &hkey_font_index, NULL ))
+            {
+                reg_save_dword( hkey_font_index, index_version_value, FONT_INDEX_VERSION );
+                reg_save_dword( hkey_font_index, index_language_value, GetSystemDefaultLangID() );
+                reg_save_dword( hkey_font_index, index_freetype_value, FT_SimpleVersion );
+                RegSetValueExA( hkey_font_index, index_build_value, 0, REG_SZ,
+                                (const BYTE *)build, strlen( build ) + 1 );
+            }
+        }
+    }
+    RegCloseKey( hkey_wine_fonts );
+    if (!hkey_font_index) return;
+
+    reg_load_dword( hkey_font_index, index_generation_value, &generation );
+    font_index_generation = generation + 1;
+    reg_save_dword( hkey_font_index, index_generation_value, font_index_generation );
+}
+
+/* remove the entries of font files that haven't been seen during this scan */
+static void close_font_index(void)
+{
+    WCHAR buffer[MAX_PATH];
+    DWORD size, generation, index = 0;
+    HKEY hkey_file;
+
+    if (!hkey_font_index) return;
+
+    size = sizeof(buffer) / sizeof(WCHAR);
+    while (!RegEnumKeyExW( hkey_font_index, index, buffer, &size, NULL, NULL, NULL, NULL ))
+    {
+        generation = 0;
+        if (!RegOpenKeyExW( hkey_font_index, buffer, 0, KEY_READ, &hkey_file ))
+        {
+            reg_load_dword( hkey_file, index_generation_value, &generation );
+            RegCloseKey( hkey_file );
+        }
+        if (generation != font_index_generation)
+        {
+            TRACE( "removing %s from the font index\n", debugstr_w(buffer) );
+            RegDeleteTreeW( hkey_font_index, buffer );
+        }
+        else index++;
+        size = sizeof(buffer) / sizeof(WCHAR);
+    }
+    RegCloseKey( hkey_font_index );
+    hkey_font_index = 0;
+}
+
+static WCHAR *get_font_index_name( const char *file )
+{
+    WCHAR *name = towstr( CP_UNIXCP, file );
+
+    /* key names are limited in length and can't contain backslashes */
+    if (strlenW( name ) >= MAX_PATH || strchrW( name, '\\' ))
+    {
+        HeapFree( GetProcessHeap(), 0, name );
+        return NULL;
+    }
+    return name;
+}
+
+static WCHAR *get_index_face_name( const struct font_index_face *rec, int which )
+{
+    const WCHAR *ptr = (const WCHAR *)(rec + 1);
+    int i;
+
+    if (!rec->name_len[which]) return NULL;
+    for (i = 0; i < which; i++) ptr += rec->name_len[i];
+    return strdupW( ptr );
+}
+
+static void load_face_from_index( const struct font_index_face *rec, const char *file,
+                                  const struct stat *st, DWORD flags )
+{
+    Face *face = HeapAlloc( GetProcessHeap(), 0, sizeof(*face) );
+    Family *family;
+
+    flags |= rec->flags & ADDFONT_VERTICAL_FONT;
+    if (!HIWORD( flags )) flags |= ADDFONT_AA_FLAGS( default_aa_flags );
+
+    face->refcount = 1;
+    face->StyleName = get_index_face_name( rec, 2 );
+    face->FullName = get_index_face_name( rec, 3 );
+    face->file = towstr( CP_UNIXCP, file );
+    face->dev = st->st_dev;
+    face->ino = st->st_ino;
+    face->font_data_ptr = NULL;
+    face->font_data_size = 0;
+    face->face_index = rec->face_index;
+    face->fs = rec->fs;
+    face->ntmFlags = rec->ntm_flags;
+    face->font_version = rec->font_version;
+    face->scalable = rec->scalable;
+    memset( &face->size, 0, sizeof(face->size) );
+    if (!face->scalable)
+    {
+        face->size.height = rec->height;
+        face->size.width = rec->width;
+        face->size.size = rec->bitmap_size;
+        face->size.x_ppem = rec->x_ppem;
+        face->size.y_ppem = rec->y_ppem;
+        face->size.internal_leading = rec->internal_leading;
+    }
+    face->flags = flags;
+    face->family = NULL;
+    face->cached_enum_data = NULL;
+
+    family = get_family_from_names( get_index_face_name( rec, 0 ), get_index_face_name( rec, 1 ));
+    add_face_to_family( face, family, flags );
+}
+
+/* check that an entry was written for the current version of the file */
+static LONG load_font_index_stamp( HKEY hkey_file, int mode, const struct font_index_stamp *expect )
+{
+    struct font_index_stamp stamp;
+    DWORD type, size = sizeof(stamp);
+    LONG ret;
+
+    if ((ret = RegQueryValueExW( hkey_file, index_stamp_value[mode], NULL, &type, (BYTE *)&stamp, &size )))
+        return ret;
+    if (type != REG_BINARY || size != sizeof(stamp) ||
+        stamp.size != expect->size || stamp.mtime != expect->mtime)
+        return ERROR_FILE_NOT_FOUND;
+    return ERROR_SUCCESS;
+}
+
+/* returns -1 if the file isn't in the index, or has been modified since */
+static INT load_font_from_index( const char *file, DWORD flags )
+{
+    struct font_index_stamp stamp;
+    struct stat st;
+    const struct font_index_face *rec;
+    WCHAR *name;
+    BYTE *data = NULL;
+    DWORD type, size;
+    HKEY hkey_file;
+    INT ret = -1;
+    int mode = (flags & ADDFONT_ALLOW_BITMAP) != 0;
+
+    if (stat( file, &st ) == -1) return -1;
+    if (!(name = get_font_index_name( file ))) return -1;
+    if (RegOpenKeyExW( hkey_font_index, name, 0, KEY_ALL_ACCESS, &hkey_file ))
+    {
+        HeapFree( GetProcessHeap(), 0, name );
+        return -1;
+    }
+    HeapFree( GetProcessHeap(), 0, name );
+
+    stamp.size = st.st_size;
+    stamp.mtime = st.st_mtime;
+    if (load_font_index_stamp( hkey_file, mode, &stamp )) goto done;
+
+    size = 0;
+    if (RegQueryValueExW( hkey_file, index_faces_value[mode], NULL, &type, NULL, &size ) || type != REG_BINARY)
+        goto done;
+    if (size && (!(data = HeapAlloc( GetProcessHeap(), 0, size )) ||
+                 RegQueryValueExW( hkey_file, index_faces_value[mode], NULL, NULL, data, &size ))) goto done;
+
+    /* validate the records before adding anything */
+    for (rec = (const struct font_index_face *)data; (BYTE *)rec < data + size;
+         rec = (const struct font_index_face *)((const BYTE *)rec + rec->size))
+    {
+        DWORD len = sizeof(*rec) / sizeof(WCHAR);
+        int i;
+
+        if (data + size - (const BYTE *)rec < sizeof(*rec)) goto done;
+        for (i = 0; i < 4; i++) len += rec->name_len[i];
+        if (rec->size != ((len * sizeof(WCHAR) + 3) & ~3) || data + size - (const BYTE *)rec < rec->size)
+            goto done;
+        if (!rec->name_len[0] || !rec->name_len[2]) goto done;
+    }
+
+    TRACE( "loading %s from the font index\n", debugstr_a(file) );
+    ret = 0;
+    for (rec = (const struct font_index_face *)data; (BYTE *)rec < data + size;
+         rec = (const struct font_index_face *)((const BYTE *)rec + rec->size))
+    {
+        load_face_from_index( rec, file, &st, flags );
+        ret++;
+    }
+    reg_save_dword( hkey_file, index_generation_value, font_index_generation );
+
+done:
+    HeapFree( GetProcessHeap(), 0, data );
+    RegCloseKey( hkey_file );
+    return ret;
+}
+
+static void add_face_to_index( const Face *face, const Family *family )
+{
+    struct font_index_file *index = font_index_file;
+    struct font_index_face *rec;
+    const WCHAR *names[4];
+    WCHAR *ptr;
+    DWORD size = sizeof(*rec);
+    int i;
+
+    names[0] = family->FamilyName;
+    names[1] = family->EnglishName;
+    names[2] = face->StyleName;
+    names[3] = face->FullName;
+    for (i = 0; i < 4; i++) if (names[i]) size += (strlenW( names[i] ) + 1) * sizeof(WCHAR);
+    size = (size + 3) & ~3;
+
+    if (index->data_len + size > index->data_size)
+    {
+        DWORD new_size = max( index->data_size * 2, index->data_len + size );
+        BYTE *new_data;
+
+        if (index->data) new_data = HeapReAlloc( GetProcessHeap(), 0, index->data, new_size );
+        else new_data = HeapAlloc( GetProcessHeap(), 0, new_size );
+        if (!new_data) return;
+        index->data = new_data;
+        index->data_size = new_size;
+    }
+
+    rec = (struct font_index_face *)(index->data + index->data_len);
+    memset( rec, 0, size );
+    rec->size = size;
+    rec->flags = face->flags & ADDFONT_VERTICAL_FONT;
+    rec->face_index = face->face_index;
+    rec->ntm_flags = face->ntmFlags;
+    rec->font_version = face->font_version;
+    rec->fs = face->fs;
+    rec->scalable = face->scalable;
+    if (!face->scalable)
+    {
+        rec->height = face->size.height;
+        rec->width = face->size.width;
+        rec->bitmap_size = face->size.size;
+        rec->x_ppem = face->size.x_ppem;
+        rec->y_ppem = face->size.y_ppem;
+        rec->internal_leading = face->size.internal_leading;
+    }
+    ptr = (WCHAR *)(rec + 1);
+    for (i = 0; i < 4; i++)
+    {
+        if (!names[i]) continue;
+        rec->name_len[i] = strlenW( names[i] ) + 1;
+        memcpy( ptr, names[i], rec->name_len[i] * sizeof(WCHAR) );
+        ptr += rec->name_len[i];
+    }
+    index->data_len += size;
+    index->count++;
+}
+
 static void AddFaceToList(FT_Face ft_face, const char *file, void *font_data_ptr, DWORD font_data_size,
                           FT_Long face_index, DWORD flags )
 {
@@ -2048,16 +2408,8 @@ static void AddFaceToList(FT_Face ft_face, const char *file, void *font_data_ptr
         return;
     }
 
-    if (insert_face_in_family_list( face, family ))
-    {
-        if (flags & ADDFONT_ADD_TO_CACHE)
-            add_face_to_cache( face );
-
-        TRACE("Added font %s %s\n", debugstr_w(family->FamilyName),
-              debugstr_w(face->StyleName));
-    }
-    release_face( face );
-    release_family( family );
+    if (font_index_file) add_face_to_index( face, family );
+    add_face_to_family( face, family, flags );
 }
 
 static FT_Face new_ft_face( const char *file, void *font_data_ptr, DWORD font_data_size,
@@ -2136,7 +2488,67 @@ fail:
     return NULL;
 }
 
+static INT load_font_file( const char *file, void *font_data_ptr, DWORD font_data_size, DWORD flags );
+
 static INT AddFontToList(const char *file, void *font_data_ptr, DWORD font_data_size, DWORD flags)
+{
+    struct font_index_file index;
+    struct font_index_stamp stamp;
+    struct stat st;
+    WCHAR *name;
+    INT ret;
+    int mode = (flags & ADDFONT_ALLOW_BITMAP) != 0;
+
+    if (font_index_file)
+    {
+        struct font_index_file *outer = font_index_file;
+
+        font_index_file = NULL;
+        ret = load_font_file( file, font_data_ptr, font_data_size, flags );
+        font_index_file = outer;
+        outer->nested = TRUE;
+        return ret;
+    }
+    if (!file || !(flags & ADDFONT_ADD_TO_CACHE) || !hkey_font_index)
+        return load_font_file( file, font_data_ptr, font_data_size, flags );
+
+    if ((ret = load_font_from_index( file, flags )) != -1) return ret;
+
+    memset( &index, 0, sizeof(index) );
+    if (stat( file, &st ) == -1 || !(name = get_font_index_name( file )))
+        return load_font_file( file, font_data_ptr, font_data_size, flags );
+
+    font_index_file = &index;
+    ret = load_font_file( file, font_data_ptr, font_data_size, flags );
+    font_index_file = NULL;
+
+    if (!RegCreateKeyExW( hkey_font_index, name, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &index.hkey, NULL ))
+    {
+        /* the entries of the other mode are stale too if the file has changed */
+        stamp.size = st.st_size;
+        stamp.mtime = st.st_mtime;
+        RegDeleteValueW( index.hkey, index_stamp_value[mode] );
+        if (load_font_index_stamp( index.hkey, !mode, &stamp ))
+        {
+            RegDeleteValueW( index.hkey, index_stamp_value[!mode] );
+            RegDeleteValueW( index.hkey, index_faces_value[!mode] );
+        }
+        /* faces that couldn't be recorded make the file uncacheable */
+        if (ret == index.count && !index.nested)
+        {
+            RegSetValueExW( index.hkey, index_faces_value[mode], 0, REG_BINARY, index.data, index.data_len );
+            reg_save_dword( index.hkey, index_generation_value, font_index_generation );
+            /* written last, so that an incomplete entry is never considered valid */
+            RegSetValueExW( index.hkey, index_stamp_value[mode], 0, REG_BINARY, (BYTE *)&stamp, sizeof(stamp) );
+        }
+        RegCloseKey( index.hkey );
+    }
+    HeapFree( GetProcessHeap(), 0, index.data );
+    HeapFree( GetProcessHeap(), 0, name );
+    return ret;
+}
+
+static INT load_font_file( const char *file, void *font_data_ptr, DWORD font_data_size, DWORD flags )
 {
     FT_Face ft_face;
     FT_Long face_index = 0, num_faces;
@@ -4152,7 +4564,11 @@ BOOL WineEngInit(void)
     create_font_cache_key(&hkey_font_cache, &disposition);
 
     if(disposition == REG_CREATED_NEW_KEY)
+    {
+        open_font_index();
         init_font_list();
+        close_font_index();
+    }
     else
         load_font_list_from_cache(hkey_font_cache);
 
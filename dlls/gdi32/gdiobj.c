@@ -655,6 +655,7 @@ BOOL WINAPI DllMain( HINSTANCE inst, DWORD reason, LPVOID reserved )
 
     gdi32_module = inst;
     DisableThreadLibraryCalls( inst );
+    init_dib_primitives();
     WineEngInit();
 
     /* create stock objects */
@@ -21,6 +21,7 @@
 
 #include <stdarg.h>
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "windef.h"
@@ -28,6 +29,7 @@
 #include "winerror.h"
 #include "wingdi.h"
 #include "winuser.h"
+#include "winreg.h"
 #include "mmsystem.h"
 
 #include "wine/test.h"
@@ -3453,6 +3455,55 @@ static INT check_StretchDIBits_stretch( HDC hdcDst, UINT32 *dstBuffer, UINT32 *s
     return ret;
 }
 
+static void test_StretchBlt_halftone(void)
+{
+    BITMAPINFO info;
+    HDC hdc, src_dc;
+    HBITMAP dib, src_dib;
+    DWORD *bits, *src_bits;
+    int x;
+
+    memset( &info, 0, sizeof(info) );
+    info.bmiHeader.biSize        = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth       = 256;
+    info.bmiHeader.biHeight      = -1;
+    info.bmiHeader.biPlanes      = 1;
+    info.bmiHeader.biBitCount    = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    src_dib = CreateDIBSection( 0, &info, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    ok( src_dib != NULL, "failed to create dib\n" );
+    info.bmiHeader.biWidth       = 700;
+    dib = CreateDIBSection( 0, &info, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    ok( dib != NULL, "failed to create dib\n" );
+
+    hdc = CreateCompatibleDC( 0 );
+    src_dc = CreateCompatibleDC( 0 );
+    SelectObject( hdc, dib );
+    SelectObject( src_dc, src_dib );
+    SetStretchBltMode( hdc, HALFTONE );
+
+    /* a gradient stays monotone */
+    for (x = 0; x < 256; x++) src_bits[x] = x * 0x010101;
+    StretchBlt( hdc, 0, 0, 64, 1, src_dc, 0, 0, 256, 1, SRCCOPY );
+    for (x = 1; x < 64; x++) if ((bits[x] & 0xff) < (bits[x - 1] & 0xff)) break;
+    ok( x == 64, "%d: got %06x after %06x\n", x, bits[x], bits[x - 1] );
+
+    StretchBlt( hdc, 0, 0, 700, 1, src_dc, 0, 0, 256, 1, SRCCOPY );
+    for (x = 1; x < 700; x++) if ((bits[x] & 0xff) < (bits[x - 1] & 0xff)) break;
+    ok( x == 700, "%d: got %06x after %06x\n", x, bits[x % 700], bits[x - 1] );
+
+    /* large shrinks average all the source pixels instead of picking some of them */
+    for (x = 0; x < 256; x++) src_bits[x] = (x & 1) ? 0xffffff : 0;
+    StretchBlt( hdc, 0, 0, 51, 1, src_dc, 0, 0, 255, 1, SRCCOPY );
+    for (x = 0; x < 51; x++) if ((bits[x] & 0xff) < 0x40 || (bits[x] & 0xff) > 0xc0) break;
+    ok( x == 51, "%d: got %06x\n", x, bits[x] );
+
+    DeleteDC( hdc );
+    DeleteDC( src_dc );
+    DeleteObject( dib );
+    DeleteObject( src_dib );
+}
+
 static void test_StretchDIBits(void)
 {
     HBITMAP bmpDst;
@@ -3814,6 +3865,112 @@ static void test_GdiAlphaBlend(void)
     HeapFree(GetProcessHeap(), 0, bmi);
 }
 
+static BYTE blend_channel( BYTE dst, BYTE src, DWORD alpha )
+{
+    return (src * alpha + dst * (255 - alpha) + 127) / 255;
+}
+
+static DWORD blend_pixel( DWORD dst, DWORD src, BLENDFUNCTION blend )
+{
+    DWORD i, ret = 0, alpha = blend.SourceConstantAlpha;
+
+    if (blend.AlphaFormat & AC_SRC_ALPHA)
+    {
+        DWORD src_alpha = ((src >> 24) * alpha + 127) / 255;
+
+        for (i = 0; i < 32; i += 8)
+        {
+            BYTE s = (((src >> i) & 0xff) * alpha + 127) / 255;
+            ret |= (s + (((dst >> i) & 0xff) * (255 - src_alpha) + 127) / 255) << i;
+        }
+        return ret;
+    }
+    for (i = 0; i < 32; i += 8) ret |= blend_channel( dst >> i, src >> i, alpha ) << i;
+    return ret;
+}
+
+static void test_GdiAlphaBlend_pixels(void)
+{
+    static const BYTE alphas[] = { 0, 1, 64, 127, 128, 200, 254, 255 };
+    static const int width = 37, height = 5;  /* not a multiple of any vector size */
+    BITMAPINFO info;
+    HDC hdc_src, hdc_dst;
+    HBITMAP bmp_src, bmp_dst;
+    DWORD *src_bits, *dst_bits, *orig, *expect;
+    BLENDFUNCTION blend;
+    DWORD seed = 12345;
+    int i, j, fmt, count = width * height;
+    BOOL ret;
+
+    if (!pGdiAlphaBlend)
+    {
+        win_skip("GdiAlphaBlend() is not implemented\n");
+        return;
+    }
+
+    memset( &info, 0, sizeof(info) );
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    hdc_src = CreateCompatibleDC( 0 );
+    hdc_dst = CreateCompatibleDC( 0 );
+    bmp_src = CreateDIBSection( hdc_src, &info, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    bmp_dst = CreateDIBSection( hdc_dst, &info, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+    SelectObject( hdc_src, bmp_src );
+    SelectObject( hdc_dst, bmp_dst );
+    orig = HeapAlloc( GetProcessHeap(), 0, count * sizeof(DWORD) );
+    expect = HeapAlloc( GetProcessHeap(), 0, count * sizeof(DWORD) );
+
+    for (i = 0; i < count; i++)
+    {
+        DWORD a, pixel;
+
+        seed = seed * 1103515245 + 12345;
+        pixel = seed;
+        /* use premultiplied source pixels, the result of other ones is not well defined */
+        a = pixel >> 24;
+        src_bits[i] = (a << 24) | (((pixel >> 16) & 0xff) * a / 255) << 16 |
+                      (((pixel >> 8) & 0xff) * a / 255) << 8 | ((pixel & 0xff) * a / 255);
+        seed = seed * 1103515245 + 12345;
+        orig[i] = seed;
+    }
+    /* a few fully opaque and fully transparent pixels too */
+    src_bits[3] = 0xff123456;
+    src_bits[4] = 0;
+
+    blend.BlendOp = AC_SRC_OVER;
+    blend.BlendFlags = 0;
+    for (fmt = 0; fmt < 2; fmt++)
+    {
+        blend.AlphaFormat = fmt ? AC_SRC_ALPHA : 0;
+        for (i = 0; i < sizeof(alphas) / sizeof(alphas[0]); i++)
+        {
+            blend.SourceConstantAlpha = alphas[i];
+            memcpy( dst_bits, orig, count * sizeof(DWORD) );
+            for (j = 0; j < count; j++) expect[j] = blend_pixel( orig[j], src_bits[j], blend );
+
+            ret = pGdiAlphaBlend( hdc_dst, 0, 0, width, height, hdc_src, 0, 0, width, height, blend );
+            ok( ret, "GdiAlphaBlend failed err %u\n", GetLastError() );
+            for (j = 0; j < count; j++)
+                if (dst_bits[j] != expect[j]) break;
+            ok( j == count, "format %x alpha %u: pixel %d got %08x expected %08x (src %08x dst %08x)\n",
+                blend.AlphaFormat, alphas[i], j, j < count ? dst_bits[j] : 0, j < count ? expect[j] : 0,
+                j < count ? src_bits[j] : 0, j < count ? orig[j] : 0 );
+        }
+    }
+
+    HeapFree( GetProcessHeap(), 0, orig );
+    HeapFree( GetProcessHeap(), 0, expect );
+    DeleteDC( hdc_src );
+    DeleteDC( hdc_dst );
+    DeleteObject( bmp_src );
+    DeleteObject( bmp_dst );
+}
+
 static void test_GdiGradientFill(void)
 {
     HDC hdc;
@@ -3970,6 +4127,158 @@ static void test_clipping(void)
     DeleteDC( hdcSrc );
 }
 
+#define RENDER_WIDTH  640
+#define RENDER_HEIGHT 480
+#define RENDER_OPS    5
+
+/* large enough operations for the DIB engine to split them in bands */
+static void render_large_ops( DWORD *results )
+{
+    static const int src_width = 1000, src_height = 700;
+    BITMAPINFO info;
+    HDC hdc, src_dc;
+    HBITMAP dib, src_dib;
+    DWORD *bits, *src_bits;
+    TRIVERTEX vert[3] = { { 0, 0, 0xff00, 0x8000, 0x0000, 0 },
+                          { RENDER_WIDTH, RENDER_HEIGHT / 2, 0x0000, 0x4000, 0xff00, 0 },
+                          { RENDER_WIDTH / 3, RENDER_HEIGHT, 0x2000, 0xff00, 0x8000, 0 } };
+    GRADIENT_RECT rect = { 0, 1 };
+    GRADIENT_TRIANGLE tri = { 0, 1, 2 };
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 0x80, 0 };
+    int x, y, size = RENDER_WIDTH * RENDER_HEIGHT;
+
+    memset( &info, 0, sizeof(info) );
+    info.bmiHeader.biSize        = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth       = RENDER_WIDTH;
+    info.bmiHeader.biHeight      = -RENDER_HEIGHT;
+    info.bmiHeader.biPlanes      = 1;
+    info.bmiHeader.biBitCount    = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    dib = CreateDIBSection( 0, &info, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    ok( dib != NULL, "failed to create dib\n" );
+    info.bmiHeader.biWidth       = src_width;
+    info.bmiHeader.biHeight      = -src_height;
+    src_dib = CreateDIBSection( 0, &info, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    ok( src_dib != NULL, "failed to create dib\n" );
+    for (y = 0; y < src_height; y++)
+        for (x = 0; x < src_width; x++)
+            src_bits[y * src_width + x] = (x * 0x012345 + y * 0x006789) ^ ((x * y) & 0xff);
+
+    hdc = CreateCompatibleDC( 0 );
+    src_dc = CreateCompatibleDC( 0 );
+    SelectObject( hdc, dib );
+    SelectObject( src_dc, src_dib );
+
+    SetStretchBltMode( hdc, COLORONCOLOR );
+    StretchBlt( hdc, 0, 0, RENDER_WIDTH, RENDER_HEIGHT, src_dc, 0, 0, 200, 150, SRCCOPY );
+    memcpy( results, bits, size * sizeof(DWORD) );
+
+    StretchBlt( hdc, 0, RENDER_HEIGHT, RENDER_WIDTH, -RENDER_HEIGHT, src_dc, 13, 7, 987, 693, SRCCOPY );
+    memcpy( results + size, bits, size * sizeof(DWORD) );
+
+    SetStretchBltMode( hdc, BLACKONWHITE );
+    StretchBlt( hdc, 0, 0, RENDER_WIDTH, RENDER_HEIGHT, src_dc, 0, 0, src_width, src_height, SRCCOPY );
+    memcpy( results + 2 * size, bits, size * sizeof(DWORD) );
+
+    if (pGdiAlphaBlend)
+        pGdiAlphaBlend( hdc, 0, 0, RENDER_WIDTH, RENDER_HEIGHT, src_dc, 100, 100,
+                        RENDER_WIDTH, RENDER_HEIGHT, blend );
+    memcpy( results + 3 * size, bits, size * sizeof(DWORD) );
+
+    if (pGdiGradientFill)
+    {
+        pGdiGradientFill( hdc, vert, 2, &rect, 1, GRADIENT_FILL_RECT_H );
+        pGdiGradientFill( hdc, vert, 3, &tri, 1, GRADIENT_FILL_TRIANGLE );
+    }
+    memcpy( results + 4 * size, bits, size * sizeof(DWORD) );
+
+    DeleteDC( hdc );
+    DeleteDC( src_dc );
+    DeleteObject( dib );
+    DeleteObject( src_dib );
+}
+
+static void test_render_threads_child( const char *filename )
+{
+    DWORD written, size = RENDER_OPS * RENDER_WIDTH * RENDER_HEIGHT * sizeof(DWORD);
+    DWORD *results = HeapAlloc( GetProcessHeap(), 0, size );
+    HANDLE file;
+
+    render_large_ops( results );
+    file = CreateFileA( filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "failed to create %s\n", filename );
+    ok( WriteFile( file, results, size, &written, NULL ) && written == size, "failed to write results\n" );
+    CloseHandle( file );
+    HeapFree( GetProcessHeap(), 0, results );
+}
+
+/* Wine can render large operations on several threads, the result has to be the same */
+static void test_render_threads(void)
+{
+    static const char gdi_key[] = "Software\\Wine\\Gdi";
+    char **argv, path[MAX_PATH], filename[MAX_PATH], cmdline[2 * MAX_PATH + 32];
+    DWORD read, disposition, size = RENDER_OPS * RENDER_WIDTH * RENDER_HEIGHT * sizeof(DWORD);
+    DWORD *expect, *results;
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+    HANDLE file;
+    HKEY hkey;
+    BOOL ret;
+    int i;
+
+    if (RegCreateKeyExA( HKEY_CURRENT_USER, gdi_key, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &hkey, &disposition ))
+    {
+        skip( "can't create the Gdi key\n" );
+        return;
+    }
+    if (!RegQueryValueExA( hkey, "RenderThreads", NULL, NULL, NULL, NULL ))
+    {
+        skip( "RenderThreads is already set\n" );
+        RegCloseKey( hkey );
+        return;
+    }
+
+    expect = HeapAlloc( GetProcessHeap(), 0, size );
+    results = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, size );
+    render_large_ops( expect );
+
+    /* the setting is only read once, so the child process renders in bands */
+    RegSetValueExA( hkey, "RenderThreads", 0, REG_SZ, (const BYTE *)"4", 2 );
+
+    GetTempPathA( MAX_PATH, path );
+    GetTempFileNameA( path, "gdi", 0, filename );
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" bitmap render_threads \"%s\"", argv[0], filename );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info );
+    ok( ret, "CreateProcess failed, error %u\n", GetLastError() );
+    if (ret)
+    {
+        winetest_wait_child_process( info.hProcess );
+        CloseHandle( info.hProcess );
+        CloseHandle( info.hThread );
+    }
+
+    RegDeleteValueA( hkey, "RenderThreads" );
+    RegCloseKey( hkey );
+    if (disposition == REG_CREATED_NEW_KEY) RegDeleteKeyA( HKEY_CURRENT_USER, gdi_key );
+
+    file = CreateFileA( filename, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, 0 );
+    ret = ReadFile( file, results, size, &read, NULL );
+    ok( ret && read == size, "failed to read results, got %u bytes\n", read );
+    CloseHandle( file );
+    DeleteFileA( filename );
+
+    for (i = 0; i < RENDER_OPS; i++)
+        ok( !memcmp( expect + i * RENDER_WIDTH * RENDER_HEIGHT, results + i * RENDER_WIDTH * RENDER_HEIGHT,
+                     RENDER_WIDTH * RENDER_HEIGHT * sizeof(DWORD) ),
+            "%d: results differ when rendering on several threads\n", i );
+
+    HeapFree( GetProcessHeap(), 0, expect );
+    HeapFree( GetProcessHeap(), 0, results );
+}
+
 static void test_32bit_ddb(void)
 {
     char buffer[sizeof(BITMAPINFOHEADER) + sizeof(DWORD)];
@@ -5645,12 +5954,21 @@ static void test_SetDIBitsToDevice_RLE8(void)
 START_TEST(bitmap)
 {
     HMODULE hdll;
+    char **argv;
+    int argc;
 
     hdll = GetModuleHandleA("gdi32.dll");
     pGdiAlphaBlend   = (void*)GetProcAddress(hdll, "GdiAlphaBlend");
     pGdiGradientFill = (void*)GetProcAddress(hdll, "GdiGradientFill");
     pSetLayout       = (void*)GetProcAddress(hdll, "SetLayout");
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 4 && !strcmp( argv[2], "render_threads" ))
+    {
+        test_render_threads_child( argv[3] );
+        return;
+    }
+
     test_createdibitmap();
     test_dibsections();
     test_dib_formats();
@@ -5669,9 +5987,12 @@ START_TEST(bitmap)
     test_CreateBitmap();
     test_BitBlt();
     test_StretchBlt();
+    test_StretchBlt_halftone();
     test_StretchDIBits();
     test_GdiAlphaBlend();
+    test_GdiAlphaBlend_pixels();
     test_GdiGradientFill();
+    test_render_threads();
     test_32bit_ddb();
     test_bitmapinfoheadersize();
     test_get16dibits();
@@ -1054,6 +1054,16 @@ static void test_bitmap_font_metrics(void)
     DeleteDC(hdc);
 }
 
+/* the system bitmap fonts are loaded from .fon files */
+static void test_bitmap_font_families(void)
+{
+    static const char * const names[] = { "MS Sans Serif", "MS Serif", "Courier", "Small Fonts" };
+    int i;
+
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        ok( is_font_installed( names[i] ), "%s is not installed\n", names[i] );
+}
+
 static void test_GdiGetCharDimensions(void)
 {
     HDC hdc;
@@ -6213,6 +6223,7 @@ START_TEST(font)
     test_logfont();
     test_bitmap_font();
     test_outline_font();
+    test_bitmap_font_families();
     test_bitmap_font_metrics();
     test_GdiGetCharDimensions();
     test_GetCharABCWidths();
@@ -39,6 +39,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
 struct heap_layout
@@ -853,6 +854,80 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+static void test_low_fragmentation_heap(void)
+{
+    void *ptrs[200];
+    BYTE *p;
+    HANDLE heap;
+    ULONG info;
+    SIZE_T size;
+    BOOL ret;
+    int i, j;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapSetInformation || !pHeapQueryInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate(HEAP_NO_SERIALIZE, 0, 0);
+    ok(heap != NULL, "HeapCreate failed %u\n", GetLastError());
+    info = 2;
+    ret = pHeapSetInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(!ret, "LFH should not be allowed on a HEAP_NO_SERIALIZE heap\n");
+    HeapDestroy(heap);
+
+    heap = HeapCreate(0, 0, 0);
+    ok(heap != NULL, "HeapCreate failed %u\n", GetLastError());
+
+    info = 2;
+    ret = pHeapSetInformation(heap, HeapCompatibilityInformation, &info, sizeof(info) - 1);
+    ok(!ret, "HeapSetInformation should fail\n");
+
+    ret = pHeapSetInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(ret, "HeapSetInformation error %u\n", GetLastError());
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation(heap, HeapCompatibilityInformation, &info, sizeof(info), &size);
+    ok(ret, "HeapQueryInformation error %u\n", GetLastError());
+    ok(info == 2, "expected 2, got %u\n", info);
+
+    for (j = 0; j < 3; j++)
+    {
+        for (i = 0; i < sizeof(ptrs)/sizeof(ptrs[0]); i++)
+        {
+            size = 1 + (i * 7) % 500;
+            ptrs[i] = HeapAlloc(heap, 0, size);
+            ok(ptrs[i] != NULL, "HeapAlloc failed for size %lu\n", size);
+            ok(HeapSize(heap, 0, ptrs[i]) == size, "wrong size %lu/%lu\n",
+               HeapSize(heap, 0, ptrs[i]), size);
+            memset(ptrs[i], 0xcc, size);
+        }
+        for (i = 0; i < sizeof(ptrs)/sizeof(ptrs[0]); i += 2)
+        {
+            ret = HeapFree(heap, 0, ptrs[i]);
+            ok(ret, "HeapFree failed %u\n", GetLastError());
+        }
+        ok(HeapValidate(heap, 0, NULL), "heap is not valid\n");
+        for (i = 0; i < sizeof(ptrs)/sizeof(ptrs[0]); i += 2)
+        {
+            size = 1 + (i * 7) % 500;
+            p = ptrs[i] = HeapAlloc(heap, HEAP_ZERO_MEMORY, size);
+            ok(p != NULL, "HeapAlloc failed for size %lu\n", size);
+            while (size--) if (p[size]) break;
+            ok(size == ~(SIZE_T)0, "block %p not zeroed at %lu\n", p, size);
+        }
+        for (i = 0; i < sizeof(ptrs)/sizeof(ptrs[0]); i++)
+        {
+            ret = HeapFree(heap, 0, ptrs[i]);
+            ok(ret, "HeapFree failed %u\n", GetLastError());
+        }
+    }
+    ok(HeapValidate(heap, 0, NULL), "heap is not valid\n");
+
+    HeapDestroy(heap);
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1173,6 +1248,7 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), (2 << 20));
     test_sized_HeapReAlloc((1 << 20), 1);
     test_HeapQueryInformation();
+    test_low_fragmentation_heap();
 
     if (pRtlGetNtGlobalFlags)
     {
@@ -415,6 +415,76 @@ static void test_VirtualAlloc(void)
     ok(VirtualFree(addr1, 0, MEM_RELEASE), "VirtualFree failed\n");
 }
 
+static void test_many_views(void)
+{
+    static const SIZE_T size = 0x10000;
+    MEMORY_BASIC_INFORMATION info;
+    char *addrs[1024], *reused[512];
+    DWORD states[512];
+    BOOL freed[512];
+    char *addr;
+    BOOL ret;
+    int i;
+
+    for (i = 0; i < sizeof(addrs)/sizeof(addrs[0]); i++)
+    {
+        addrs[i] = VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+        ok(addrs[i] != NULL, "%d: VirtualAlloc failed %u\n", i, GetLastError());
+        if (!addrs[i]) break;
+        addr = VirtualAlloc(addrs[i] + size / 2, 0x1000, MEM_COMMIT, PAGE_READWRITE);
+        ok(addr == addrs[i] + size / 2, "%d: VirtualAlloc returned %p/%p\n", i, addr, addrs[i]);
+    }
+    if (i < sizeof(addrs)/sizeof(addrs[0]))
+    {
+        while (i--) VirtualFree(addrs[i], 0, MEM_RELEASE);
+        return;
+    }
+
+    /* free every other view and take the holes again before anything else, test output
+     * included, gets a chance to allocate in them; the results are checked afterwards */
+    for (i = 0; i < sizeof(addrs)/sizeof(addrs[0]); i += 2)
+        freed[i / 2] = VirtualFree(addrs[i], 0, MEM_RELEASE);
+    for (i = 0; i < sizeof(addrs)/sizeof(addrs[0]); i += 2)
+    {
+        if (VirtualQuery(addrs[i] + size / 2, &info, sizeof(info)) == sizeof(info))
+            states[i / 2] = info.State;
+        else
+            states[i / 2] = 0;
+    }
+    for (i = 0; i < sizeof(addrs)/sizeof(addrs[0]); i += 2)
+        reused[i / 2] = VirtualAlloc(addrs[i], size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+    for (i = 0; i < sizeof(addrs)/sizeof(addrs[0]); i++)
+    {
+        if (i & 1)
+        {
+            ok(VirtualQuery(addrs[i] + size / 2, &info, sizeof(info)) == sizeof(info),
+               "%d: VirtualQuery failed\n", i);
+            ok(info.AllocationBase == addrs[i], "%d: %p != %p\n", i, info.AllocationBase, addrs[i]);
+            ok(info.BaseAddress == addrs[i] + size / 2, "%d: %p != %p\n",
+               i, info.BaseAddress, addrs[i] + size / 2);
+            ok(info.RegionSize == 0x1000, "%d: wrong size %lx\n", i, info.RegionSize);
+            ok(info.State == MEM_COMMIT, "%d: wrong state %x\n", i, info.State);
+            ok(info.Protect == PAGE_READWRITE, "%d: wrong protection %x\n", i, info.Protect);
+        }
+        else
+        {
+            ok(freed[i / 2], "%d: VirtualFree failed\n", i);
+            ok(states[i / 2] == MEM_FREE, "%d: wrong state %x\n", i, states[i / 2]);
+            ok(reused[i / 2] == addrs[i] || broken(!reused[i / 2]) /* taken by another thread */,
+               "%d: VirtualAlloc returned %p/%p\n", i, reused[i / 2], addrs[i]);
+            addrs[i] = reused[i / 2];
+        }
+    }
+
+    for (i = 0; i < sizeof(addrs)/sizeof(addrs[0]); i++)
+    {
+        if (!addrs[i]) continue;
+        ret = VirtualFree(addrs[i], 0, MEM_RELEASE);
+        ok(ret, "%d: VirtualFree failed %u\n", i, GetLastError());
+    }
+}
+
 static void test_MapViewOfFile(void)
 {
     static const char testfile[] = "testfile.xxx";
@@ -3699,6 +3769,7 @@ START_TEST(virtual)
     test_VirtualProtect();
     test_VirtualAllocEx();
     test_VirtualAlloc();
+    test_many_views();
     test_MapViewOfFile();
     test_NtMapViewOfSection();
     test_NtAreMappedFilesTheSame();
@@ -2309,6 +2309,246 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/* Cache of the names present in recently scanned directories, so that repeated
+ * case-insensitive lookups don't need to read the whole directory every time.
+ * A cache is only trusted while the directory modification time is unchanged.
+ * Directories that are too large are remembered too, so that they are not read
+ * again for nothing until they change. */
+
+#define DIR_CACHE_SIZE         8      /* number of cached directories */
+#define DIR_CACHE_MAX_ENTRIES  65536  /* larger directories are not cached */
+
+struct dir_cache_entry
+{
+    struct dir_cache_entry *next;       /* next entry in the same hash bucket */
+    unsigned int            hash;       /* hash of the case-folded name */
+    unsigned int            len;        /* length of the name in WCHARs */
+    char                   *unix_name;  /* Unix name, stored after the DOS name */
+    WCHAR                   name[1];    /* DOS name */
+};
+
+struct dir_cache
+{
+    dev_t                    dev;
+    ino_t                    ino;
+    time_t                   mtime;
+    long                     mtime_nsec;
+    unsigned int             hash_size;  /* size of the hash table, 0 if the slot is unused */
+    BOOL                     too_large;  /* directory is too large to be cached, no hash table */
+    struct dir_cache_entry **hash;
+    unsigned int             last_use;
+    unsigned int             hits;       /* lookups answered from the cache */
+    unsigned int             misses;     /* lookups that needed to read the directory */
+};
+
+static struct dir_cache dir_cache[DIR_CACHE_SIZE];
+static unsigned int dir_cache_clock;
+
+static RTL_CRITICAL_SECTION dir_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG dir_cache_critsect_debug =
+{
+    0, 0, &dir_cache_section,
+    { &dir_cache_critsect_debug.ProcessLocksList, &dir_cache_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": dir_cache_section") }
+};
+static RTL_CRITICAL_SECTION dir_cache_section = { &dir_cache_critsect_debug, -1, 0, 0, 0, 0 };
+
+static inline long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+static inline unsigned int hash_dir_entry_name( const WCHAR *name, int len )
+{
+    unsigned int hash = 0;
+    while (len--) hash = hash * 31 + tolowerW( *name++ );
+    return hash;
+}
+
+/***********************************************************************
+ *           free_dir_cache
+ *
+ * dir_cache_section must be held by caller.
+ */
+static void free_dir_cache( struct dir_cache *cache )
+{
+    struct dir_cache_entry *entry, *next;
+    unsigned int i;
+
+    cache->too_large = FALSE;
+    if (!cache->hash_size) return;
+
+    TRACE( "dev %x ino %x: %u hits %u misses\n", (int)cache->dev, (int)cache->ino,
+           cache->hits, cache->misses );
+    for (i = 0; i < cache->hash_size; i++)
+    {
+        for (entry = cache->hash[i]; entry; entry = next)
+        {
+            next = entry->next;
+            RtlFreeHeap( GetProcessHeap(), 0, entry );
+        }
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, cache->hash );
+    cache->hash = NULL;
+    cache->hash_size = 0;
+}
+
+/***********************************************************************
+ *           fill_dir_cache
+ *
+ * Read all the names of a directory into a cache slot.
+ * dir_cache_section must be held by caller.
+ */
+static BOOL fill_dir_cache( struct dir_cache *cache, const char *unix_name, const struct stat *st )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_cache_entry *entry, *next, *list = NULL;
+    unsigned int count = 0, size = 16;
+    struct dirent *de;
+    DIR *dir;
+    int len;
+
+    if (!(dir = opendir( unix_name ))) return FALSE;
+    while ((de = readdir( dir )))
+    {
+        size_t unix_len = strlen( de->d_name ) + 1;
+
+        len = ntdll_umbstowcs( 0, de->d_name, unix_len - 1, buffer, MAX_DIR_ENTRY_LEN );
+        if (len <= 0) continue;
+        if (++count > DIR_CACHE_MAX_ENTRIES) break;
+        if (!(entry = RtlAllocateHeap( GetProcessHeap(), 0,
+                                       offsetof( struct dir_cache_entry, name[len] ) + unix_len )))
+            break;
+        entry->hash = hash_dir_entry_name( buffer, len );
+        entry->len = len;
+        memcpy( entry->name, buffer, len * sizeof(WCHAR) );
+        entry->unix_name = (char *)&entry->name[len];
+        memcpy( entry->unix_name, de->d_name, unix_len );
+        entry->next = list;
+        list = entry;
+    }
+    closedir( dir );
+
+    if (!de)
+    {
+        while (size < count) size *= 2;
+        cache->hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(*cache->hash) );
+    }
+    if (de || !cache->hash)
+    {
+        for (entry = list; entry; entry = next)
+        {
+            next = entry->next;
+            RtlFreeHeap( GetProcessHeap(), 0, entry );
+        }
+        if (count > DIR_CACHE_MAX_ENTRIES)
+        {
+            TRACE( "%s has more than %u entries, not caching it\n", debugstr_a(unix_name), DIR_CACHE_MAX_ENTRIES );
+            cache->too_large  = TRUE;
+            cache->dev        = st->st_dev;
+            cache->ino        = st->st_ino;
+            cache->mtime      = st->st_mtime;
+            cache->mtime_nsec = get_mtime_nsec( st );
+        }
+        return FALSE;
+    }
+
+    /* the list is in reverse readdir order, pushing onto the buckets restores it,
+     * so that we find the same file as a directory scan would */
+    for (entry = list; entry; entry = next)
+    {
+        next = entry->next;
+        entry->next = cache->hash[entry->hash & (size - 1)];
+        cache->hash[entry->hash & (size - 1)] = entry;
+    }
+    cache->hash_size  = size;
+    cache->dev        = st->st_dev;
+    cache->ino        = st->st_ino;
+    cache->mtime      = st->st_mtime;
+    cache->mtime_nsec = get_mtime_nsec( st );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Look for a file name in the cached contents of the directory unix_name.
+ * On success the Unix name is appended to unix_name at pos, like find_file_in_dir does.
+ * Returns STATUS_NOT_FOUND if the cache cannot tell whether the file exists.
+ */
+static NTSTATUS lookup_dir_cache( char *unix_name, int pos, const WCHAR *name, int length,
+                                  BOOLEAN is_name_8_dot_3 )
+{
+    struct dir_cache *cache = NULL;
+    struct dir_cache_entry *entry;
+    NTSTATUS status = STATUS_NOT_FOUND;
+    unsigned int i, hash;
+    struct stat st;
+
+    if (stat( unix_name, &st ) == -1) return STATUS_NOT_FOUND;
+
+    /* a directory modified within the current timestamp granularity
+     * could change again without its modification time changing */
+    if (st.st_mtime >= time(NULL) - 1) return STATUS_NOT_FOUND;
+
+    RtlEnterCriticalSection( &dir_cache_section );
+
+    for (i = 0; i < DIR_CACHE_SIZE; i++)
+    {
+        if (!dir_cache[i].hash_size && !dir_cache[i].too_large) continue;
+        if (dir_cache[i].dev != st.st_dev || dir_cache[i].ino != st.st_ino) continue;
+        cache = &dir_cache[i];
+        cache->last_use = ++dir_cache_clock;
+        if (cache->mtime != st.st_mtime || cache->mtime_nsec != get_mtime_nsec( &st ))
+        {
+            free_dir_cache( cache );
+            if (!fill_dir_cache( cache, unix_name, &st )) goto done;
+            cache->misses++;
+        }
+        else if (cache->too_large) goto done;
+        else cache->hits++;
+        break;
+    }
+
+    if (!cache)
+    {
+        /* replace the least recently used slot */
+        cache = &dir_cache[0];
+        for (i = 1; i < DIR_CACHE_SIZE; i++)
+            if (dir_cache[i].last_use < cache->last_use) cache = &dir_cache[i];
+        free_dir_cache( cache );
+        cache->last_use = ++dir_cache_clock;
+        if (!fill_dir_cache( cache, unix_name, &st )) goto done;
+        cache->hits = 0;
+        cache->misses = 1;
+    }
+
+    hash = hash_dir_entry_name( name, length );
+    for (entry = cache->hash[hash & (cache->hash_size - 1)]; entry; entry = entry->next)
+    {
+        if (entry->hash != hash || entry->len != length) continue;
+        if (memicmpW( entry->name, name, length )) continue;
+        unix_name[pos - 1] = '/';
+        strcpy( unix_name + pos, entry->unix_name );
+        status = STATUS_SUCCESS;
+        goto done;
+    }
+
+    /* short names are not cached, the caller needs to scan for them */
+    if (!is_name_8_dot_3) status = STATUS_OBJECT_PATH_NOT_FOUND;
+
+done:
+    RtlLeaveCriticalSection( &dir_cache_section );
+    return status;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2419,6 +2659,14 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    switch (lookup_dir_cache( unix_name, pos, name, length, is_name_8_dot_3 ))
+    {
+    case STATUS_SUCCESS:
+        goto success;
+    case STATUS_OBJECT_PATH_NOT_FOUND:
+        goto not_found;
+    }
+
     if (!(dir = opendir( unix_name )))
     {
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
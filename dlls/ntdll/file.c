@@ -57,6 +57,9 @@
 #ifdef HAVE_SYS_SOCKET_H
 #include <sys/socket.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #ifdef HAVE_UTIME_H
 # include <utime.h>
 #endif
@@ -992,6 +995,27 @@ err:
 }
 
 
+#if defined(HAVE_PREADV) || defined(HAVE_PWRITEV)
+/* maximum number of segments submitted in a single preadv/pwritev call */
+#define MAX_SEGMENT_IOVECS 256
+
+/* fill an iovec array from page-sized segments, starting at offset pos in the first one */
+static int get_segment_iovecs( struct iovec *iov, const FILE_SEGMENT_ELEMENT *segments,
+                               ULONG pos, ULONG length )
+{
+    int count;
+
+    for (count = 0; count < MAX_SEGMENT_IOVECS && length; count++, segments++)
+    {
+        iov[count].iov_base = (char *)segments->Buffer + pos;
+        iov[count].iov_len  = min( page_size - pos, length );
+        length -= iov[count].iov_len;
+        pos = 0;
+    }
+    return count;
+}
+#endif
+
 /******************************************************************************
  *  NtReadFileScatter   [NTDLL.@]
  *  ZwReadFileScatter   [NTDLL.@]
@@ -1028,11 +1052,21 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
 
     while (length)
     {
+#ifdef HAVE_PREADV
+        struct iovec iov[MAX_SEGMENT_IOVECS];
+        int count = get_segment_iovecs( iov, segments, pos, length );
+
+        if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            result = preadv( unix_handle, iov, count, offset->QuadPart + total );
+        else
+            result = readv( unix_handle, iov, count );
+#else
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
             result = pread( unix_handle, (char *)segments->Buffer + pos,
                             page_size - pos, offset->QuadPart + total );
         else
             result = read( unix_handle, (char *)segments->Buffer + pos, page_size - pos );
+#endif
 
         if (result == -1)
         {
@@ -1047,11 +1081,9 @@ NTSTATUS WINAPI NtReadFileScatter( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         }
         total += result;
         length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
+        pos += result;
+        segments += pos / page_size;
+        pos %= page_size;
     }
 
     send_completion = cvalue != 0;
@@ -1434,11 +1466,21 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
 
     while (length)
     {
+#ifdef HAVE_PWRITEV
+        struct iovec iov[MAX_SEGMENT_IOVECS];
+        int count = get_segment_iovecs( iov, segments, pos, length );
+
+        if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            result = pwritev( unix_handle, iov, count, offset->QuadPart + total );
+        else
+            result = writev( unix_handle, iov, count );
+#else
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
             result = pwrite( unix_handle, (char *)segments->Buffer + pos,
                              page_size - pos, offset->QuadPart + total );
         else
             result = write( unix_handle, (char *)segments->Buffer + pos, page_size - pos );
+#endif
 
         if (result == -1)
         {
@@ -1458,11 +1500,9 @@ NTSTATUS WINAPI NtWriteFileGather( HANDLE file, HANDLE event, PIO_APC_ROUTINE ap
         }
         total += result;
         length -= result;
-        if ((pos += result) == page_size)
-        {
-            pos = 0;
-            segments++;
-        }
+        pos += result;
+        segments += pos / page_size;
+        pos %= page_size;
     }
 
     send_completion = cvalue != 0;
@@ -158,6 +158,8 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    SLIST_HEADER    *lookaside;     /* Low-fragmentation front end lists, indexed by block size */
+    LONG             lfh_busy;      /* Number of lock-free front end allocations in progress */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -166,6 +168,11 @@ typedef struct tagHEAP
 #define COMMIT_MASK          0xffff  /* bitmask for commit/decommit granularity */
 #define MAX_FREE_PENDING     1024    /* max number of free requests to delay */
 
+/* low-fragmentation front end */
+#define HEAP_LFH_MAX_SIZE    0x400   /* max block size handled by the front end */
+#define HEAP_LFH_MAX_CACHE   0x8000  /* max number of bytes kept in each size class */
+#define HEAP_LFH_NB_LISTS    (HEAP_LFH_MAX_SIZE / ALIGNMENT + 1)
+
 /* some undocumented flags (names are made up) */
 #define HEAP_PAGE_ALLOCS      0x01000000
 #define HEAP_VALIDATE         0x10000000
@@ -657,6 +664,12 @@ static void HEAP_MakeInUseBlockFree( SUBHEAP *subheap, ARENA_INUSE *pArena )
     if ((char *)pFree + size < (char *)subheap->base + subheap->size)
         return;  /* Not the last block, so nothing more to do */
 
+    /* A concurrent lfh_allocate may still read the list link of a block that
+     * has just been popped, so keep the memory around until the next time if
+     * one is in progress. Allocations starting later only see cached blocks,
+     * which are in use and can't be part of the freed range. */
+    if (heap->lfh_busy) return;
+
     /* Free the whole sub-heap if it's empty and not the original one */
 
     if (((char *)pFree == (char *)subheap->base + subheap->headerSize) &&
@@ -859,6 +872,118 @@ static BOOL validate_large_arena( HEAP *heap, const ARENA_LARGE *arena, BOOL qui
 }
 
 
+/***********************************************************************
+ *           enable_lfh
+ *
+ * Enable the low-fragmentation front end. Freed small blocks are kept on
+ * lock-free lists indexed by block size, so that most allocations don't
+ * need to take the heap critical section, and frees don't need to merge
+ * blocks.
+ */
+static NTSTATUS enable_lfh( HEAP *heap )
+{
+    SLIST_HEADER *lists = NULL;
+    SIZE_T size = HEAP_LFH_NB_LISTS * sizeof(*lists);
+    unsigned int i;
+
+    if (heap->lookaside) return STATUS_SUCCESS;
+
+    /* the front end doesn't do any checking, and requires serialization */
+    if ((heap->flags & (HEAP_NO_SERIALIZE | HEAP_SHARED | HEAP_PAGE_ALLOCS | HEAP_VALIDATE |
+                        HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED)) || RUNNING_ON_VALGRIND)
+        return STATUS_UNSUCCESSFUL;
+
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), (void **)&lists, 4, &size, MEM_COMMIT, PAGE_READWRITE ))
+        return STATUS_NO_MEMORY;
+    for (i = 0; i < HEAP_LFH_NB_LISTS; i++) RtlInitializeSListHead( &lists[i] );
+
+    if (interlocked_cmpxchg_ptr( (void **)&heap->lookaside, lists, NULL ))
+    {
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), (void **)&lists, &size, MEM_RELEASE );
+    }
+    TRACE( "enabled low-fragmentation front end for heap %p\n", heap );
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           lfh_allocate
+ *
+ * Try to allocate a block from the low-fragmentation front end lists.
+ */
+static void *lfh_allocate( HEAP *heap, DWORD flags, SIZE_T size, SIZE_T rounded_size )
+{
+    SLIST_ENTRY *entry;
+    ARENA_INUSE *arena;
+
+    interlocked_xchg_add( &heap->lfh_busy, 1 );
+    entry = RtlInterlockedPopEntrySList( &heap->lookaside[rounded_size / ALIGNMENT] );
+    interlocked_xchg_add( &heap->lfh_busy, -1 );
+    if (!entry) return NULL;
+
+    /* all blocks of a given list have the same size, there's no need to shrink it */
+    arena = (ARENA_INUSE *)entry - 1;
+    arena->magic = ARENA_INUSE_MAGIC;
+    arena->unused_bytes = (arena->size & ARENA_SIZE_MASK) - size;
+
+    notify_alloc( arena + 1, size, flags & HEAP_ZERO_MEMORY );
+    initialize_block( arena + 1, size, arena->unused_bytes, flags );
+    return arena + 1;
+}
+
+
+/***********************************************************************
+ *           lfh_free
+ *
+ * Try to return a block to the low-fragmentation front end lists.
+ * Blocks on the lists are still in use for the rest of the heap code, and
+ * marked as pending so that double frees can be caught.
+ * Must be called with the heap lock held, on a block that has been validated.
+ */
+static BOOL lfh_free( HEAP *heap, ARENA_INUSE *arena )
+{
+    SLIST_HEADER *list;
+    SIZE_T size = arena->size & ARENA_SIZE_MASK;
+
+    if (size > HEAP_LFH_MAX_SIZE) return FALSE;
+
+    list = &heap->lookaside[size / ALIGNMENT];
+    if (RtlQueryDepthSList( list ) >= HEAP_LFH_MAX_CACHE / size) return FALSE;
+
+    arena->magic = ARENA_PENDING_MAGIC;
+    RtlInterlockedPushEntrySList( list, (SLIST_ENTRY *)(arena + 1) );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_flush
+ *
+ * Give all the blocks cached by the front end back to the heap.
+ * Must be called with the heap lock held.
+ */
+static void lfh_flush( HEAP *heap )
+{
+    SLIST_ENTRY *entry, *next;
+    ARENA_INUSE *arena;
+    unsigned int i;
+
+    if (!heap->lookaside) return;
+
+    for (i = 0; i < HEAP_LFH_NB_LISTS; i++)
+    {
+        for (entry = RtlInterlockedFlushSList( &heap->lookaside[i] ); entry; entry = next)
+        {
+            next = entry->Next;
+            arena = (ARENA_INUSE *)entry - 1;
+            arena->magic = ARENA_INUSE_MAGIC;
+            HEAP_MakeInUseBlockFree( HEAP_FindSubHeap( heap, arena ), arena );
+        }
+    }
+}
+
+
 /***********************************************************************
  *           HEAP_CreateSubHeap
  */
@@ -1330,6 +1455,9 @@ static BOOL HEAP_IsRealArena( HEAP *heapPtr,   /* [in] ptr to the heap */
     if (!(flags & HEAP_NO_SERIALIZE))
         RtlEnterCriticalSection( &heapPtr->critSection );
 
+    /* blocks cached by the front end are not valid in-use blocks */
+    lfh_flush( heapPtr );
+
     if (block)  /* only check this single memory block */
     {
         const ARENA_INUSE *arena = (const ARENA_INUSE *)block - 1;
@@ -1627,6 +1755,12 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
         addr = heapPtr->pending_free;
         NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
     }
+    if (heapPtr->lookaside)
+    {
+        size = 0;
+        addr = heapPtr->lookaside;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
     size = 0;
     addr = heapPtr->subheap.base;
     NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
@@ -1672,6 +1806,13 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lookaside && rounded_size <= HEAP_LFH_MAX_SIZE &&
+        (pInUse = lfh_allocate( heapPtr, flags, size, rounded_size )))
+    {
+        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, pInUse );
+        return pInUse;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
@@ -1766,7 +1907,7 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 
     if (!subheap)
         free_large_block( heapPtr, flags, ptr );
-    else
+    else if (!heapPtr->lookaside || !lfh_free( heapPtr, pInUse ))
         HEAP_MakeInUseBlockFree( subheap, pInUse );
 
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
@@ -2098,6 +2239,7 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
     if (!entry->lpData) /* first call (init) ? */
     {
         TRACE("begin walking of heap %p.\n", heap);
+        lfh_flush( heapPtr );
         currentheap = &heapPtr->subheap;
         ptr = (char*)currentheap->base + currentheap->headerSize;
     }
@@ -2235,6 +2377,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2243,7 +2387,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        *(ULONG *)info = heapPtr->lookaside ? 2 /* LFH */ : 0 /* standard heap */;
         return STATUS_SUCCESS;
 
     default:
@@ -2257,6 +2402,29 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+
+    TRACE("%p %d %p %ld\n", heap, info_class, info, size);
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* standard heap, can't go back once the front end is enabled */
+            return heapPtr->lookaside ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 2:  /* low-fragmentation heap */
+            return enable_lfh( heapPtr );
+        default:
+            FIXME("unsupported compatibility mode %u\n", *(ULONG *)info);
+            return STATUS_UNSUCCESSFUL;
+        }
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
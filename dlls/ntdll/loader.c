@@ -77,6 +77,7 @@ typedef struct _wine_modref
     LDR_MODULE            ldr;
     int                   nDeps;
     struct _wine_modref **deps;
+    struct _wine_modref  *hash_next;  /* next module in the same base name hash bucket */
 } WINE_MODREF;
 
 /* info about the current builtin dll load */
@@ -106,6 +107,10 @@ static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
 };
 static RTL_CRITICAL_SECTION loader_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 
+/* modules hashed by base name, each bucket is kept in load order */
+#define MODULE_HASH_SIZE 64
+static WINE_MODREF *module_hash[MODULE_HASH_SIZE];
+
 static WINE_MODREF *cached_modref;
 static WINE_MODREF *current_modref;
 static WINE_MODREF *last_failed_modref;
@@ -354,6 +359,52 @@ static WINE_MODREF *get_modref( HMODULE hmod )
 }
 
 
+/**********************************************************************
+ *	    hash_basename
+ *
+ * Case-insensitive hash of the base name part of a module path.
+ */
+static unsigned int hash_basename( LPCWSTR name )
+{
+    const WCHAR *p;
+    unsigned int hash = 0;
+
+    if ((p = strrchrW( name, '\\' ))) name = p + 1;
+    while (*name) hash = hash * 65599 + tolowerW( *name++ );
+    return hash % MODULE_HASH_SIZE;
+}
+
+
+/**********************************************************************
+ *	    add_module_hash
+ *
+ * Add a module to the base name hash, after any module already using the same name.
+ * The loader_section must be locked while calling this function
+ */
+static void add_module_hash( WINE_MODREF *wm )
+{
+    WINE_MODREF **next = &module_hash[hash_basename( wm->ldr.BaseDllName.Buffer )];
+
+    while (*next) next = &(*next)->hash_next;
+    wm->hash_next = NULL;
+    *next = wm;
+}
+
+
+/**********************************************************************
+ *	    remove_module_hash
+ *
+ * The loader_section must be locked while calling this function
+ */
+static void remove_module_hash( WINE_MODREF *wm )
+{
+    WINE_MODREF **next = &module_hash[hash_basename( wm->ldr.BaseDllName.Buffer )];
+
+    while (*next && *next != wm) next = &(*next)->hash_next;
+    if (*next) *next = wm->hash_next;
+}
+
+
 /**********************************************************************
  *	    find_basename_module
  *
@@ -362,20 +413,15 @@ static WINE_MODREF *get_modref( HMODULE hmod )
  */
 static WINE_MODREF *find_basename_module( LPCWSTR name )
 {
-    PLIST_ENTRY mark, entry;
+    WINE_MODREF *wm;
 
     if (cached_modref && !strcmpiW( name, cached_modref->ldr.BaseDllName.Buffer ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    for (wm = module_hash[hash_basename( name )]; wm; wm = wm->hash_next)
     {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (!strcmpiW( name, mod->BaseDllName.Buffer ))
-        {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
-        }
+        if (!strcmpiW( name, wm->ldr.BaseDllName.Buffer ))
+            return cached_modref = wm;
     }
     return NULL;
 }
@@ -389,20 +435,16 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
  */
 static WINE_MODREF *find_fullname_module( LPCWSTR name )
 {
-    PLIST_ENTRY mark, entry;
+    WINE_MODREF *wm;
 
     if (cached_modref && !strcmpiW( name, cached_modref->ldr.FullDllName.Buffer ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
-    for (entry = mark->Flink; entry != mark; entry = entry->Flink)
+    /* the base name is the last path component, so both names hash the same */
+    for (wm = module_hash[hash_basename( name )]; wm; wm = wm->hash_next)
     {
-        LDR_MODULE *mod = CONTAINING_RECORD(entry, LDR_MODULE, InLoadOrderModuleList);
-        if (!strcmpiW( name, mod->FullDllName.Buffer ))
-        {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
-            return cached_modref;
-        }
+        if (!strcmpiW( name, wm->ldr.FullDllName.Buffer ))
+            return cached_modref = wm;
     }
     return NULL;
 }
@@ -942,6 +984,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, LPCWSTR filename )
 
     InsertTailList(&NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList,
                    &wm->ldr.InLoadOrderModuleList);
+    add_module_hash( wm );
 
     /* insert module in MemoryList, sorted in increasing base addresses */
     mark = &NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList;
@@ -1568,6 +1611,7 @@ static void load_builtin_callback( void *module, const char *filename )
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            remove_module_hash( wm );
             /* FIXME: free the modref */
             builtin_load_info->status = STATUS_DLL_NOT_FOUND;
             return;
@@ -1644,6 +1688,7 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, LPCWSTR name, HANDLE file,
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
             RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+            remove_module_hash( wm );
 
             /* FIXME: there are several more dangling references
              * left. Including dlls loaded by this dll before the
@@ -2622,6 +2667,7 @@ static void free_modref( WINE_MODREF *wm )
 {
     RemoveEntryList(&wm->ldr.InLoadOrderModuleList);
     RemoveEntryList(&wm->ldr.InMemoryOrderModuleList);
+    remove_module_hash( wm );
     if (wm->ldr.InInitializationOrderModuleList.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderModuleList);
 
@@ -270,9 +270,37 @@ static void read_reply_data( void *buffer, size_t size )
  */
 static inline unsigned int wait_reply( struct __server_request_info *req )
 {
-    read_reply_data( &req->u.reply, sizeof(req->u.reply) );
-    if (req->u.reply.reply_header.reply_size)
-        read_reply_data( req->reply_data, req->u.reply.reply_header.reply_size );
+    struct iovec vec[2];
+    data_size_t max_size = req->u.req.request_header.reply_size;
+    data_size_t size;
+    int ret;
+
+    /* the server sends the header and the data with a single writev, so in the
+     * common case both can be fetched with one system call */
+    vec[0].iov_base = &req->u.reply;
+    vec[0].iov_len  = sizeof(req->u.reply);
+    vec[1].iov_base = req->reply_data;
+    vec[1].iov_len  = max_size;
+
+    for (;;)
+    {
+        if ((ret = readv( ntdll_get_thread_data()->reply_fd, vec, max_size ? 2 : 1 )) > 0) break;
+        if (!ret) abort_thread(0);  /* the server closed the connection */
+        if (errno == EINTR) continue;
+        if (errno == EPIPE) abort_thread(0);
+        server_protocol_perror("read");
+    }
+
+    if (ret < sizeof(req->u.reply))
+    {
+        read_reply_data( (char *)&req->u.reply + ret, sizeof(req->u.reply) - ret );
+        ret = 0;
+    }
+    else ret -= sizeof(req->u.reply);
+
+    size = req->u.reply.reply_header.reply_size;
+    if (ret > size) server_protocol_error( "reply too large %d/%u\n", ret, size );
+    if (size > ret) read_reply_data( (char *)req->reply_data + ret, size - ret );
     return req->u.reply.reply_header.error;
 }
 
@@ -26,7 +26,11 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <signal.h>
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
@@ -72,6 +76,399 @@ static inline int interlocked_dec_if_nonzero( int *dest )
     return val;
 }
 
+/* stack node of a thread waiting for a RtlRunOnce initialization in progress */
+struct once_waiter
+{
+    ULONG_PTR next;
+    int       done;
+};
+
+#ifdef __linux__
+
+static int wait_op = 128; /*FUTEX_WAIT|FUTEX_PRIVATE_FLAG*/
+static int wake_op = 129; /*FUTEX_WAKE|FUTEX_PRIVATE_FLAG*/
+
+static inline int futex_wait( const int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, wait_op, val, timeout, 0, 0 );
+}
+
+static inline int futex_wake( const int *addr, int val )
+{
+    return syscall( __NR_futex, addr, wake_op, val, NULL, 0, 0 );
+}
+
+static inline int futex_wait_bitset( const int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, wait_op + 9 /*FUTEX_WAIT_BITSET*/, val, NULL, 0, mask );
+}
+
+static inline int futex_wake_bitset( const int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, wake_op + 9 /*FUTEX_WAKE_BITSET*/, val, NULL, 0, mask );
+}
+
+static inline int use_futexes(void)
+{
+    static int supported = -1;
+
+    if (supported == -1)
+    {
+        futex_wait( &supported, 10, NULL );
+        if (errno == ENOSYS)
+        {
+            wait_op = 0; /*FUTEX_WAIT*/
+            wake_op = 1; /*FUTEX_WAKE*/
+            futex_wait( &supported, 10, NULL );
+        }
+        supported = (errno != ENOSYS);
+    }
+    return supported;
+}
+
+/* convert an NT timeout to the relative timespec expected by futex_wait */
+static struct timespec *get_futex_timeout( struct timespec *ts, const LARGE_INTEGER *timeout )
+{
+    LONGLONG diff;
+
+    if (!timeout) return NULL;
+
+    if (timeout->QuadPart > 0)
+    {
+        LARGE_INTEGER now;
+        NtQuerySystemTime( &now );
+        diff = timeout->QuadPart - now.QuadPart;
+    }
+    else diff = -timeout->QuadPart;
+
+    if (diff < 0) diff = 0;
+    ts->tv_sec  = diff / 10000000;
+    ts->tv_nsec = (diff % 10000000) * 100;
+    return ts;
+}
+
+static NTSTATUS fast_wait_once( struct once_waiter *waiter )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    while (!*(volatile int *)&waiter->done)
+        futex_wait( &waiter->done, 0, NULL );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_wake_once( struct once_waiter *waiter )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    /* the waiter may return as soon as done is set, waking a stale
+     * address afterwards is harmless */
+    interlocked_xchg( &waiter->done, 1 );
+    futex_wake( &waiter->done, 1 );
+    return STATUS_SUCCESS;
+}
+
+/* The futex based SRW lock keeps the following in the first 32 bits of the lock:
+ *
+ * 32 31            16               0
+ *  ________________ ________________
+ * | X| #exclusive  |    #shared     |
+ *  ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+ * X is set while the lock is owned exclusively, #exclusive counts the threads
+ * waiting for exclusive access and #shared the current shared owners. Shared
+ * waiters are not counted, they are simply woken all at once by the futex
+ * bitset when the exclusive queue drains.
+ */
+#define SRW_FUTEX_EXCLUSIVE_LOCK_BIT        0x80000000
+#define SRW_FUTEX_EXCLUSIVE_WAITERS_MASK    0x7fff0000
+#define SRW_FUTEX_EXCLUSIVE_WAITERS_INC     0x00010000
+#define SRW_FUTEX_SHARED_OWNERS_MASK        0x0000ffff
+#define SRW_FUTEX_SHARED_OWNERS_INC         0x00000001
+
+#define SRW_FUTEX_BITSET_EXCLUSIVE          1
+#define SRW_FUTEX_BITSET_SHARED             2
+
+static inline int *get_srw_futex( RTL_SRWLOCK *lock )
+{
+    /* futexes need to be 4-byte aligned, otherwise use the keyed event path */
+    if ((ULONG_PTR)&lock->Ptr & 3) return NULL;
+    return (int *)&lock->Ptr;
+}
+
+static NTSTATUS fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int old, new, *futex;
+    NTSTATUS ret;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    if (!(futex = get_srw_futex( lock ))) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *futex;
+
+        if (!(old & SRW_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRW_FUTEX_SHARED_OWNERS_MASK))
+        {
+            new = old | SRW_FUTEX_EXCLUSIVE_LOCK_BIT;
+            ret = STATUS_SUCCESS;
+        }
+        else
+        {
+            new = old;
+            ret = STATUS_TIMEOUT;
+        }
+    } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+    return ret;
+}
+
+static NTSTATUS fast_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int old, new, *futex;
+    BOOLEAN wait;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    if (!(futex = get_srw_futex( lock ))) return STATUS_NOT_IMPLEMENTED;
+
+    /* Register ourselves as an exclusive waiter first, so that new shared
+     * owners are held back. */
+    do
+    {
+        old = *futex;
+        if ((old & SRW_FUTEX_EXCLUSIVE_WAITERS_MASK) == SRW_FUTEX_EXCLUSIVE_WAITERS_MASK)
+            RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+        new = old + SRW_FUTEX_EXCLUSIVE_WAITERS_INC;
+    } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+    for (;;)
+    {
+        do
+        {
+            old = *futex;
+
+            if (!(old & SRW_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRW_FUTEX_SHARED_OWNERS_MASK))
+            {
+                /* Not locked exclusive or shared. We can try to grab it. */
+                new = old | SRW_FUTEX_EXCLUSIVE_LOCK_BIT;
+                new -= SRW_FUTEX_EXCLUSIVE_WAITERS_INC;
+                wait = FALSE;
+            }
+            else
+            {
+                new = old;
+                wait = TRUE;
+            }
+        } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+        if (!wait) return STATUS_SUCCESS;
+
+        futex_wait_bitset( futex, new, SRW_FUTEX_BITSET_EXCLUSIVE );
+    }
+}
+
+static NTSTATUS fast_try_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    int old, new, *futex;
+    NTSTATUS ret;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    if (!(futex = get_srw_futex( lock ))) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *futex;
+
+        if (!(old & SRW_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRW_FUTEX_EXCLUSIVE_WAITERS_MASK))
+        {
+            /* Not locked exclusive, and no exclusive waiters. We can try to
+             * grab it. */
+            if ((old & SRW_FUTEX_SHARED_OWNERS_MASK) == SRW_FUTEX_SHARED_OWNERS_MASK)
+                RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+            new = old + SRW_FUTEX_SHARED_OWNERS_INC;
+            ret = STATUS_SUCCESS;
+        }
+        else
+        {
+            new = old;
+            ret = STATUS_TIMEOUT;
+        }
+    } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+    return ret;
+}
+
+static NTSTATUS fast_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    int old, new, *futex;
+    BOOLEAN wait;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    if (!(futex = get_srw_futex( lock ))) return STATUS_NOT_IMPLEMENTED;
+
+    for (;;)
+    {
+        do
+        {
+            old = *futex;
+
+            if (!(old & SRW_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRW_FUTEX_EXCLUSIVE_WAITERS_MASK))
+            {
+                if ((old & SRW_FUTEX_SHARED_OWNERS_MASK) == SRW_FUTEX_SHARED_OWNERS_MASK)
+                    RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+                new = old + SRW_FUTEX_SHARED_OWNERS_INC;
+                wait = FALSE;
+            }
+            else
+            {
+                new = old;
+                wait = TRUE;
+            }
+        } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+        if (!wait) return STATUS_SUCCESS;
+
+        futex_wait_bitset( futex, new, SRW_FUTEX_BITSET_SHARED );
+    }
+}
+
+static NTSTATUS fast_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int old, new, *futex;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    if (!(futex = get_srw_futex( lock ))) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *futex;
+
+        if (!(old & SRW_FUTEX_EXCLUSIVE_LOCK_BIT))
+        {
+            ERR("Lock %p is not owned exclusive! (%#x)\n", lock, *futex);
+            return STATUS_RESOURCE_NOT_OWNED;
+        }
+
+        new = old & ~SRW_FUTEX_EXCLUSIVE_LOCK_BIT;
+    } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+    /* exclusive waiters are processed first, followed by the shared ones */
+    if (new & SRW_FUTEX_EXCLUSIVE_WAITERS_MASK)
+        futex_wake_bitset( futex, 1, SRW_FUTEX_BITSET_EXCLUSIVE );
+    else
+        futex_wake_bitset( futex, INT_MAX, SRW_FUTEX_BITSET_SHARED );
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    int old, new, *futex;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    if (!(futex = get_srw_futex( lock ))) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *futex;
+
+        if (old & SRW_FUTEX_EXCLUSIVE_LOCK_BIT)
+        {
+            ERR("Lock %p is owned exclusive! (%#x)\n", lock, *futex);
+            return STATUS_RESOURCE_NOT_OWNED;
+        }
+        else if (!(old & SRW_FUTEX_SHARED_OWNERS_MASK))
+        {
+            ERR("Lock %p is not owned shared! (%#x)\n", lock, *futex);
+            return STATUS_RESOURCE_NOT_OWNED;
+        }
+
+        new = old - SRW_FUTEX_SHARED_OWNERS_INC;
+    } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+    /* Optimization: only bother waking if there are actually exclusive waiters. */
+    if (!(new & SRW_FUTEX_SHARED_OWNERS_MASK) && (new & SRW_FUTEX_EXCLUSIVE_WAITERS_MASK))
+        futex_wake_bitset( futex, 1, SRW_FUTEX_BITSET_EXCLUSIVE );
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_wait_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    struct timespec ts;
+
+    if (futex_wait( (const int *)&variable->Ptr, val, get_futex_timeout( &ts, timeout ) ) == -1 &&
+        errno == ETIMEDOUT)
+        return STATUS_TIMEOUT;
+    return STATUS_WAIT_0;
+}
+
+static NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    futex_wake( (const int *)&variable->Ptr, count );
+    return STATUS_SUCCESS;
+}
+
+#else
+
+static inline int use_futexes(void)
+{
+    return 0;
+}
+
+static NTSTATUS fast_wait_once( struct once_waiter *waiter )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_wake_once( struct once_waiter *waiter )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_try_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_wait_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif
+
 /* creates a struct security_descriptor and contained information in one contiguous piece of memory */
 NTSTATUS NTDLL_create_struct_sd(PSECURITY_DESCRIPTOR nt_sd, struct security_descriptor **server_sd,
                                 data_size_t *server_sd_len)
@@ -1277,6 +1674,60 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
     return status;
 }
 
+/******************************************************************
+ *              NtRemoveIoCompletionEx (NTDLL.@)
+ *              ZwRemoveIoCompletionEx (NTDLL.@)
+ *
+ * (Wait for and) retrieve up to count completion messages from the completion object's queue
+ */
+NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE port, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
+                                        ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
+{
+    completion_msg_t msgs[64];
+    NTSTATUS status;
+    ULONG i = 0;
+
+    TRACE( "%p %p %u %p %p %u\n", port, info, count, written, timeout, alertable );
+
+    for (;;)
+    {
+        while (i < count)
+        {
+            ULONG j, nb = min( count - i, sizeof(msgs) / sizeof(msgs[0]) ), ret = 0;
+
+            SERVER_START_REQ( remove_completions )
+            {
+                req->handle = wine_server_obj_handle( port );
+                wine_server_set_reply( req, msgs, nb * sizeof(msgs[0]) );
+                if (!(status = wine_server_call( req )))
+                    ret = wine_server_reply_size( reply ) / sizeof(msgs[0]);
+            }
+            SERVER_END_REQ;
+
+            for (j = 0; j < ret; j++, i++)
+            {
+                info[i].CompletionKey             = msgs[j].ckey;
+                info[i].CompletionValue           = msgs[j].cvalue;
+                info[i].IoStatusBlock.Information = msgs[j].information;
+                info[i].IoStatusBlock.u.Status    = msgs[j].status;
+            }
+            if (status || ret < nb) break;  /* queue is empty now */
+        }
+
+        if (i || status != STATUS_PENDING)
+        {
+            if (status == STATUS_PENDING) status = STATUS_SUCCESS;
+            break;
+        }
+
+        status = NtWaitForSingleObject( port, alertable, timeout );
+        if (status != WAIT_OBJECT_0) break;
+    }
+
+    *written = i ? i : 1;
+    return status;
+}
+
 /******************************************************************
  *              NtOpenIoCompletion (NTDLL.@)
  *              ZwOpenIoCompletion (NTDLL.@)
@@ -1405,7 +1856,8 @@ DWORD WINAPI RtlRunOnceBeginInitialize( RTL_RUN_ONCE *once, ULONG flags, void **
 
     for (;;)
     {
-        ULONG_PTR next, val = (ULONG_PTR)once->Ptr;
+        struct once_waiter waiter;
+        ULONG_PTR val = (ULONG_PTR)once->Ptr;
 
         switch (val & 3)
         {
@@ -1417,10 +1869,14 @@ DWORD WINAPI RtlRunOnceBeginInitialize( RTL_RUN_ONCE *once, ULONG flags, void **
 
         case 1:  /* in progress, wait */
             if (flags & RTL_RUN_ONCE_ASYNC) return STATUS_INVALID_PARAMETER;
-            next = val & ~3;
-            if (interlocked_cmpxchg_ptr( &once->Ptr, (void *)((ULONG_PTR)&next | 1),
+            waiter.next = val & ~3;
+            waiter.done = 0;
+            if (interlocked_cmpxchg_ptr( &once->Ptr, (void *)((ULONG_PTR)&waiter | 1),
                                          (void *)val ) == (void *)val)
-                NtWaitForKeyedEvent( keyed_event, &next, FALSE, NULL );
+            {
+                if (fast_wait_once( &waiter ) == STATUS_NOT_IMPLEMENTED)
+                    NtWaitForKeyedEvent( keyed_event, &waiter, FALSE, NULL );
+            }
             break;
 
         case 2:  /* done */
@@ -1459,8 +1915,10 @@ DWORD WINAPI RtlRunOnceComplete( RTL_RUN_ONCE *once, ULONG flags, void *context
             val &= ~3;
             while (val)
             {
-                ULONG_PTR next = *(ULONG_PTR *)val;
-                NtReleaseKeyedEvent( keyed_event, (void *)val, FALSE, NULL );
+                struct once_waiter *waiter = (struct once_waiter *)val;
+                ULONG_PTR next = waiter->next;
+                if (fast_wake_once( waiter ) == STATUS_NOT_IMPLEMENTED)
+                    NtReleaseKeyedEvent( keyed_event, waiter, FALSE, NULL );
                 val = next;
             }
             return STATUS_SUCCESS;
@@ -1623,9 +2081,10 @@ static inline void srwlock_leave_shared( RTL_SRWLOCK *lock, unsigned int val )
  * NOTES
  *  Please note that SRWLocks do not keep track of the owner of a lock.
  *  It doesn't make any difference which thread for example unlocks an
- *  SRWLock (see corresponding tests). This implementation uses two
- *  keyed events (one for the exclusive waiters and one for the shared
- *  waiters) and is limited to 2^15-1 waiting threads.
+ *  SRWLock (see corresponding tests). On Linux the lock is a futex;
+ *  elsewhere this implementation uses two keyed events (one for the
+ *  exclusive waiters and one for the shared waiters). Both are limited
+ *  to 2^15-1 waiting threads.
  */
 void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
 {
@@ -1642,6 +2101,9 @@ void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (fast_acquire_srw_exclusive( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     if (srwlock_lock_exclusive( (unsigned int *)&lock->Ptr, SRWLOCK_RES_EXCLUSIVE ))
         NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
 }
@@ -1656,6 +2118,10 @@ void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+
+    if (fast_acquire_srw_shared( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     /* Acquires a shared lock. If it's currently not possible to add elements to
      * the shared queue, then request exclusive access instead. */
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
@@ -1686,6 +2152,11 @@ void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    NTSTATUS status = fast_release_srw_exclusive( lock );
+
+    if (status == STATUS_RESOURCE_NOT_OWNED) RtlRaiseStatus( status );
+    if (status != STATUS_NOT_IMPLEMENTED) return;
+
     srwlock_leave_exclusive( lock, srwlock_unlock_exclusive( (unsigned int *)&lock->Ptr,
                              - SRWLOCK_RES_EXCLUSIVE ) - SRWLOCK_RES_EXCLUSIVE );
 }
@@ -1695,6 +2166,11 @@ void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
 {
+    NTSTATUS status = fast_release_srw_shared( lock );
+
+    if (status == STATUS_RESOURCE_NOT_OWNED) RtlRaiseStatus( status );
+    if (status != STATUS_NOT_IMPLEMENTED) return;
+
     srwlock_leave_shared( lock, srwlock_lock_exclusive( (unsigned int *)&lock->Ptr,
                           - SRWLOCK_RES_SHARED ) - SRWLOCK_RES_SHARED );
 }
@@ -1708,6 +2184,11 @@ void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
  */
 BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    NTSTATUS status;
+
+    if ((status = fast_try_acquire_srw_exclusive( lock )) != STATUS_NOT_IMPLEMENTED)
+        return (status == STATUS_SUCCESS);
+
     return interlocked_cmpxchg( (int *)&lock->Ptr, SRWLOCK_MASK_IN_EXCLUSIVE |
                                 SRWLOCK_RES_EXCLUSIVE, 0 ) == 0;
 }
@@ -1718,6 +2199,11 @@ BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 BOOLEAN WINAPI RtlTryAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+    NTSTATUS status;
+
+    if ((status = fast_try_acquire_srw_shared( lock )) != STATUS_NOT_IMPLEMENTED)
+        return (status == STATUS_SUCCESS);
+
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
     {
         if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
@@ -1761,6 +2247,9 @@ void WINAPI RtlInitializeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
+    if (fast_wake_cv( variable, 1 ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     if (interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1772,7 +2261,12 @@ void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeAllConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
-    int val = interlocked_xchg( (int *)&variable->Ptr, 0 );
+    int val;
+
+    if (fast_wake_cv( variable, INT_MAX ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
+    val = interlocked_xchg( (int *)&variable->Ptr, 0 );
     while (val-- > 0)
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1796,6 +2290,18 @@ NTSTATUS WINAPI RtlSleepConditionVariableCS( RTL_CONDITION_VARIABLE *variable, R
                                              const LARGE_INTEGER *timeout )
 {
     NTSTATUS status;
+
+    if (use_futexes())
+    {
+        /* the condition variable is a wake sequence counter in this case */
+        int val = *(int *)&variable->Ptr;
+
+        RtlLeaveCriticalSection( crit );
+        status = fast_wait_cv( variable, val, timeout );
+        RtlEnterCriticalSection( crit );
+        return status;
+    }
+
     interlocked_xchg_add( (int *)&variable->Ptr, 1 );
     RtlLeaveCriticalSection( crit );
 
@@ -1833,18 +2339,33 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
                                               const LARGE_INTEGER *timeout, ULONG flags )
 {
     NTSTATUS status;
-    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
 
-    if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
-        RtlReleaseSRWLockShared( lock );
-    else
-        RtlReleaseSRWLockExclusive( lock );
+    if (use_futexes())
+    {
+        int val = *(int *)&variable->Ptr;
 
-    status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
-    if (status != STATUS_SUCCESS)
+        if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
+            RtlReleaseSRWLockShared( lock );
+        else
+            RtlReleaseSRWLockExclusive( lock );
+
+        status = fast_wait_cv( variable, val, timeout );
+    }
+    else
     {
-        if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
-            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+
+        if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
+            RtlReleaseSRWLockShared( lock );
+        else
+            RtlReleaseSRWLockExclusive( lock );
+
+        status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
+        if (status != STATUS_SUCCESS)
+        {
+            if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
+                status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        }
     }
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
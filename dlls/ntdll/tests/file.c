@@ -72,6 +72,7 @@ static NTSTATUS (WINAPI *pNtCreateIoCompletion)(PHANDLE, ACCESS_MASK, POBJECT_AT
 static NTSTATUS (WINAPI *pNtOpenIoCompletion)(PHANDLE, ACCESS_MASK, POBJECT_ATTRIBUTES);
 static NTSTATUS (WINAPI *pNtQueryIoCompletion)(HANDLE, IO_COMPLETION_INFORMATION_CLASS, PVOID, ULONG, PULONG);
 static NTSTATUS (WINAPI *pNtRemoveIoCompletion)(HANDLE, PULONG_PTR, PULONG_PTR, PIO_STATUS_BLOCK, PLARGE_INTEGER);
+static NTSTATUS (WINAPI *pNtRemoveIoCompletionEx)(HANDLE, FILE_IO_COMPLETION_INFORMATION *, ULONG, ULONG *, LARGE_INTEGER *, BOOLEAN);
 static NTSTATUS (WINAPI *pNtSetIoCompletion)(HANDLE, ULONG_PTR, ULONG_PTR, NTSTATUS, SIZE_T);
 static NTSTATUS (WINAPI *pNtSetInformationFile)(HANDLE, PIO_STATUS_BLOCK, PVOID, ULONG, FILE_INFORMATION_CLASS);
 static NTSTATUS (WINAPI *pNtQueryInformationFile)(HANDLE, PIO_STATUS_BLOCK, PVOID, ULONG, FILE_INFORMATION_CLASS);
@@ -1099,6 +1100,51 @@ static void test_iocp_setcompletion(HANDLE h)
     ok( !count, "Unexpected msg count: %d\n", count );
 }
 
+static void test_iocp_removecompletionex(HANDLE h)
+{
+    FILE_IO_COMPLETION_INFORMATION info[4];
+    LARGE_INTEGER timeout;
+    NTSTATUS res;
+    ULONG i, count;
+
+    if (!pNtRemoveIoCompletionEx)
+    {
+        win_skip("NtRemoveIoCompletionEx not available\n");
+        return;
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        res = pNtSetIoCompletion( h, CKEY_FIRST + i, CVALUE_FIRST, STATUS_SUCCESS, i );
+        ok( res == STATUS_SUCCESS, "NtSetIoCompletion failed: %x\n", res );
+    }
+
+    timeout.QuadPart = 0;
+    count = 0xdeadbeef;
+    memset( info, 0xcc, sizeof(info) );
+    res = pNtRemoveIoCompletionEx( h, info, 2, &count, &timeout, FALSE );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletionEx failed: %x\n", res );
+    ok( count == 2, "got count %u\n", count );
+    ok( info[0].CompletionKey == CKEY_FIRST, "got key %lx\n", info[0].CompletionKey );
+    ok( info[1].CompletionKey == CKEY_FIRST + 1, "got key %lx\n", info[1].CompletionKey );
+    ok( info[1].CompletionValue == CVALUE_FIRST, "got value %lx\n", info[1].CompletionValue );
+    ok( info[1].IoStatusBlock.Information == 1, "got information %lu\n", info[1].IoStatusBlock.Information );
+    ok( U(info[1].IoStatusBlock).Status == STATUS_SUCCESS, "got status %x\n", U(info[1].IoStatusBlock).Status );
+
+    count = 0xdeadbeef;
+    res = pNtRemoveIoCompletionEx( h, info, 4, &count, &timeout, FALSE );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletionEx failed: %x\n", res );
+    ok( count == 1, "got count %u\n", count );
+    ok( info[0].CompletionKey == CKEY_FIRST + 2, "got key %lx\n", info[0].CompletionKey );
+
+    count = 0xdeadbeef;
+    res = pNtRemoveIoCompletionEx( h, info, 4, &count, &timeout, FALSE );
+    ok( res == STATUS_TIMEOUT, "NtRemoveIoCompletionEx returned %x\n", res );
+
+    count = get_pending_msgs(h);
+    ok( !count, "Unexpected msg count: %d\n", count );
+}
+
 static void test_iocp_fileio(HANDLE h)
 {
     static const char pipe_name[] = "\\\\.\\pipe\\iocompletiontestnamedpipe";
@@ -1635,6 +1681,7 @@ static void test_iocompletion(void)
     if ( h && h != INVALID_HANDLE_VALUE)
     {
         test_iocp_setcompletion(h);
+        test_iocp_removecompletionex(h);
         test_iocp_fileio(h);
         pNtClose(h);
     }
@@ -2832,6 +2879,7 @@ START_TEST(file)
     pNtOpenIoCompletion     = (void *)GetProcAddress(hntdll, "NtOpenIoCompletion");
     pNtQueryIoCompletion    = (void *)GetProcAddress(hntdll, "NtQueryIoCompletion");
     pNtRemoveIoCompletion   = (void *)GetProcAddress(hntdll, "NtRemoveIoCompletion");
+    pNtRemoveIoCompletionEx = (void *)GetProcAddress(hntdll, "NtRemoveIoCompletionEx");
     pNtSetIoCompletion      = (void *)GetProcAddress(hntdll, "NtSetIoCompletion");
     pNtSetInformationFile   = (void *)GetProcAddress(hntdll, "NtSetInformationFile");
     pNtQueryInformationFile = (void *)GetProcAddress(hntdll, "NtQueryInformationFile");
@@ -42,44 +42,22 @@ WINE_DEFAULT_DEBUG_CHANNEL(threadpool);
  * Old thread pooling API
  */
 
-#define OLD_WORKER_TIMEOUT 30000        /* 30 seconds */
 #define EXPIRE_NEVER       (~(ULONGLONG)0)
 #define TIMER_QUEUE_MAGIC  0x516d6954   /* TimQ */
 
-static RTL_CRITICAL_SECTION_DEBUG critsect_debug;
 static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug;
 
 static struct
 {
-    /* threadpool_cs must be held while modifying the following four elements */
-    struct list             work_item_list;
-    LONG                    num_workers;
-    LONG                    num_busy_workers;
-    LONG                    num_items_processed;
-    RTL_CONDITION_VARIABLE  threadpool_cond;
-    RTL_CRITICAL_SECTION    threadpool_cs;
     HANDLE                  compl_port;
     RTL_CRITICAL_SECTION    threadpool_compl_cs;
 }
 old_threadpool =
 {
-    LIST_INIT(old_threadpool.work_item_list),   /* work_item_list */
-    0,                                          /* num_workers */
-    0,                                          /* num_busy_workers */
-    0,                                          /* num_items_processed */
-    RTL_CONDITION_VARIABLE_INIT,                /* threadpool_cond */
-    { &critsect_debug, -1, 0, 0, 0, 0 },        /* threadpool_cs */
     NULL,                                       /* compl_port */
     { &critsect_compl_debug, -1, 0, 0, 0, 0 },  /* threadpool_compl_cs */
 };
 
-static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
-{
-    0, 0, &old_threadpool.threadpool_cs,
-    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
-      0, 0, { (DWORD_PTR)(__FILE__ ": threadpool_cs") }
-};
-
 static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug =
 {
     0, 0, &old_threadpool.threadpool_compl_cs,
@@ -87,9 +65,8 @@ static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug =
       0, 0, { (DWORD_PTR)(__FILE__ ": threadpool_compl_cs") }
 };
 
-struct work_item
+struct rtl_work_item
 {
-    struct list entry;
     PRTL_WORK_ITEM_ROUTINE function;
     PVOID context;
 };
@@ -137,8 +114,18 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_QUEUES         16    /* local queues of simple callbacks in each pool */
+#define THREADPOOL_SPIN_COUNT     16    /* yields before an idle worker goes to sleep */
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
+/* queue of simple callbacks that don't need the pool lock, see tp_object_submit */
+struct threadpool_queue
+{
+    RTL_SRWLOCK             lock;
+    /* queued objects, locked via .lock */
+    struct list             objects;
+};
+
 /* internal threadpool representation */
 struct threadpool
 {
@@ -153,7 +140,11 @@ struct threadpool
     int                     max_workers;
     int                     min_workers;
     int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_busy_workers;
+    /* local queues, indexed by thread id, and interlocked counters */
+    struct threadpool_queue queues[THREADPOOL_QUEUES];
+    LONG                    num_queued;
+    LONG                    num_spinning;
 };
 
 enum threadpool_objtype
@@ -352,7 +343,11 @@ static void CALLBACK threadpool_worker_proc( void *param );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_shutdown( struct threadpool_object *object );
 static BOOL tp_object_release( struct threadpool_object *object );
+static NTSTATUS tp_threadpool_alloc( struct threadpool **out );
+static void tp_threadpool_shutdown( struct threadpool *pool );
+static BOOL tp_threadpool_release( struct threadpool *pool );
 static struct threadpool *default_threadpool = NULL;
+static struct threadpool *rtl_work_pool = NULL;
 
 static inline LONG interlocked_inc( PLONG dest )
 {
@@ -364,47 +359,35 @@ static inline LONG interlocked_dec( PLONG dest )
     return interlocked_xchg_add( dest, -1 ) - 1;
 }
 
-static void WINAPI worker_thread_proc(void * param)
+static void CALLBACK process_rtl_work_item( TP_CALLBACK_INSTANCE *instance, void *userdata )
 {
-    struct list *item;
-    struct work_item *work_item_ptr, work_item;
-    LARGE_INTEGER timeout;
-    timeout.QuadPart = -(OLD_WORKER_TIMEOUT * (ULONGLONG)10000);
+    struct rtl_work_item *item = userdata;
 
-    RtlEnterCriticalSection( &old_threadpool.threadpool_cs );
-    old_threadpool.num_workers++;
+    TRACE("executing %p(%p)\n", item->function, item->context);
+    item->function( item->context );
 
-    for (;;)
+    RtlFreeHeap( GetProcessHeap(), 0, item );
+}
+
+/* Legacy work items frequently block for a long time (wait threads, I/O
+ * completion pollers, serial port waits), so they get a pool of their own
+ * without a worker limit instead of starving the default pool. */
+static struct threadpool *get_rtl_work_pool( void )
+{
+    struct threadpool *pool;
+
+    if (!rtl_work_pool)
     {
-        if ((item = list_head( &old_threadpool.work_item_list )))
-        {
-            work_item_ptr = LIST_ENTRY( item, struct work_item, entry );
-            list_remove( &work_item_ptr->entry );
-            old_threadpool.num_busy_workers++;
-            old_threadpool.num_items_processed++;
-            RtlLeaveCriticalSection( &old_threadpool.threadpool_cs );
-
-            /* copy item to stack and do the work */
-            work_item = *work_item_ptr;
-            RtlFreeHeap( GetProcessHeap(), 0, work_item_ptr );
-            TRACE("executing %p(%p)\n", work_item.function, work_item.context);
-            work_item.function( work_item.context );
-
-            RtlEnterCriticalSection( &old_threadpool.threadpool_cs );
-            old_threadpool.num_busy_workers--;
-        }
-        else if (RtlSleepConditionVariableCS( &old_threadpool.threadpool_cond,
-                 &old_threadpool.threadpool_cs, &timeout ) != STATUS_SUCCESS)
+        if (tp_threadpool_alloc( &pool )) return NULL;
+        pool->max_workers = INT_MAX;
+
+        if (interlocked_cmpxchg_ptr( (void *)&rtl_work_pool, pool, NULL ) != NULL)
         {
-            break;
+            tp_threadpool_shutdown( pool );
+            tp_threadpool_release( pool );
         }
     }
-
-    old_threadpool.num_workers--;
-    RtlLeaveCriticalSection( &old_threadpool.threadpool_cs );
-    RtlExitUserThread( 0 );
-
-    /* never reached */
+    return rtl_work_pool;
 }
 
 /***********************************************************************
@@ -429,59 +412,36 @@ static void WINAPI worker_thread_proc(void * param)
  *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
  *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
  */
-NTSTATUS WINAPI RtlQueueWorkItem(PRTL_WORK_ITEM_ROUTINE Function, PVOID Context, ULONG Flags)
+NTSTATUS WINAPI RtlQueueWorkItem( PRTL_WORK_ITEM_ROUTINE function, PVOID context, ULONG flags )
 {
-    HANDLE thread;
+    TP_CALLBACK_ENVIRON environment;
+    struct rtl_work_item *item;
+    struct threadpool *pool;
     NTSTATUS status;
-    LONG items_processed;
-    struct work_item *work_item = RtlAllocateHeap(GetProcessHeap(), 0, sizeof(struct work_item));
-
-    if (!work_item)
-        return STATUS_NO_MEMORY;
 
-    work_item->function = Function;
-    work_item->context = Context;
+    TRACE( "%p %p %u\n", function, context, flags );
 
-    if (Flags & ~WT_EXECUTELONGFUNCTION)
-        FIXME("Flags 0x%x not supported\n", Flags);
+    if (!(pool = get_rtl_work_pool()))
+        return STATUS_NO_MEMORY;
 
-    RtlEnterCriticalSection( &old_threadpool.threadpool_cs );
-    list_add_tail( &old_threadpool.work_item_list, &work_item->entry );
-    status = (old_threadpool.num_workers > old_threadpool.num_busy_workers) ?
-             STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
-    items_processed = old_threadpool.num_items_processed;
-    RtlLeaveCriticalSection( &old_threadpool.threadpool_cs );
+    /* FIXME: items can't be pinned to a persistent thread, they run on any worker */
+    if (flags & WT_EXECUTEINPERSISTENTTHREAD)
+        WARN( "WT_EXECUTEINPERSISTENTTHREAD not supported\n" );
 
-    /* FIXME: tune this algorithm to not be as aggressive with creating threads
-     * if WT_EXECUTELONGFUNCTION isn't specified */
-    if (status == STATUS_SUCCESS)
-        RtlWakeConditionVariable( &old_threadpool.threadpool_cond );
-    else
-    {
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      worker_thread_proc, NULL, &thread, NULL );
+    item = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*item) );
+    if (!item)
+        return STATUS_NO_MEMORY;
 
-        /* NOTE: we don't care if we couldn't create the thread if there is at
-         * least one other available to process the request */
-        if (status == STATUS_SUCCESS)
-            NtClose( thread );
-        else
-        {
-            RtlEnterCriticalSection( &old_threadpool.threadpool_cs );
-            if (old_threadpool.num_workers > 0 ||
-                old_threadpool.num_items_processed != items_processed)
-            {
-                status = STATUS_SUCCESS;
-            }
-            else
-                list_remove( &work_item->entry );
-            RtlLeaveCriticalSection( &old_threadpool.threadpool_cs );
+    memset( &environment, 0, sizeof(environment) );
+    environment.Version = 1;
+    environment.Pool = (TP_POOL *)pool;
+    environment.u.s.LongFunction = (flags & WT_EXECUTELONGFUNCTION) != 0;
 
-            if (status != STATUS_SUCCESS)
-                RtlFreeHeap( GetProcessHeap(), 0, work_item );
-        }
-    }
+    item->function = function;
+    item->context  = context;
 
+    status = TpSimpleTryPost( process_rtl_work_item, item, &environment );
+    if (status) RtlFreeHeap( GetProcessHeap(), 0, item );
     return status;
 }
 
@@ -1696,6 +1656,7 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
 static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 {
     struct threadpool *pool;
+    unsigned int i;
 
     pool = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pool) );
     if (!pool)
@@ -1716,6 +1677,14 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     pool->num_workers           = 0;
     pool->num_busy_workers      = 0;
 
+    for (i = 0; i < THREADPOOL_QUEUES; i++)
+    {
+        RtlInitializeSRWLock( &pool->queues[i].lock );
+        list_init( &pool->queues[i].objects );
+    }
+    pool->num_queued            = 0;
+    pool->num_spinning          = 0;
+
     TRACE( "allocated threadpool %p\n", pool );
 
     *out = pool;
@@ -1752,6 +1721,7 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
     assert( pool->shutdown );
     assert( !pool->objcount );
     assert( list_empty( &pool->pool ) );
+    assert( !pool->num_queued );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1793,6 +1763,20 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
         pool = default_threadpool;
     }
 
+    /* The last worker doesn't terminate while objects are left, so as long as
+     * there are some, another reference can be added without the lock. */
+    for (;;)
+    {
+        LONG count = pool->objcount;
+        if (!count) break;
+        if (interlocked_cmpxchg( &pool->objcount, count + 1, count ) == count)
+        {
+            interlocked_inc( &pool->refcount );
+            *out = pool;
+            return STATUS_SUCCESS;
+        }
+    }
+
     RtlEnterCriticalSection( &pool->cs );
 
     /* Make sure that the threadpool has at least one thread. */
@@ -1814,7 +1798,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
     if (status == STATUS_SUCCESS)
     {
         interlocked_inc( &pool->refcount );
-        pool->objcount++;
+        interlocked_inc( &pool->objcount );
     }
 
     RtlLeaveCriticalSection( &pool->cs );
@@ -1833,9 +1817,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
  */
 static void tp_threadpool_unlock( struct threadpool *pool )
 {
-    RtlEnterCriticalSection( &pool->cs );
-    pool->objcount--;
-    RtlLeaveCriticalSection( &pool->cs );
+    interlocked_dec( &pool->objcount );
     tp_threadpool_release( pool );
 }
 
@@ -1977,6 +1959,51 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     }
 }
 
+/***********************************************************************
+ *           tp_queue_push    (internal)
+ *
+ * Adds a simple callback to the local queue of the current thread.
+ */
+static void tp_queue_push( struct threadpool *pool, struct threadpool_object *object )
+{
+    struct threadpool_queue *queue = &pool->queues[(GetCurrentThreadId() / 4) % THREADPOOL_QUEUES];
+
+    interlocked_inc( &pool->num_queued );
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    list_add_tail( &queue->objects, &object->pool_entry );
+    RtlReleaseSRWLockExclusive( &queue->lock );
+}
+
+/***********************************************************************
+ *           tp_queue_pop    (internal)
+ *
+ * Removes a simple callback from the local queue of the current thread,
+ * or steals one from the other queues if it is empty.
+ */
+static struct threadpool_object *tp_queue_pop( struct threadpool *pool )
+{
+    unsigned int i, index = (GetCurrentThreadId() / 4) % THREADPOOL_QUEUES;
+    struct threadpool_queue *queue;
+    struct list *ptr;
+
+    for (i = 0; i < THREADPOOL_QUEUES; i++)
+    {
+        queue = &pool->queues[(index + i) % THREADPOOL_QUEUES];
+        if (list_empty( &queue->objects )) continue;
+
+        RtlAcquireSRWLockExclusive( &queue->lock );
+        if ((ptr = list_head( &queue->objects ))) list_remove( ptr );
+        RtlReleaseSRWLockExclusive( &queue->lock );
+
+        if (ptr)
+        {
+            interlocked_dec( &pool->num_queued );
+            return LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+        }
+    }
+    return NULL;
+}
+
 /***********************************************************************
  *           tp_object_submit    (internal)
  *
@@ -1987,10 +2014,25 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 {
     struct threadpool *pool = object->pool;
     NTSTATUS status = STATUS_UNSUCCESSFUL;
+    BOOL queued = FALSE;
 
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
+    /* Simple callbacks outside of a cleanup group can't be waited for or canceled,
+     * so they go to the local queues. The pool lock is only needed to wake up or
+     * start a worker, not when an idle one is already spinning on the queues, or
+     * when all of them are busy and no more can be started anyway; workers always
+     * look at the queues again before going to sleep. */
+    if (object->type == TP_OBJECT_TYPE_SIMPLE && !object->group)
+    {
+        interlocked_inc( &object->refcount );
+        tp_queue_push( pool, object );
+        if (pool->num_spinning || (pool->num_busy_workers >= pool->num_workers &&
+                                   pool->num_workers >= pool->max_workers)) return;
+        queued = TRUE;
+    }
+
     RtlEnterCriticalSection( &pool->cs );
 
     /* Start new worker threads if required. */
@@ -2009,9 +2051,12 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     }
 
     /* Queue work item and increment refcount. */
-    interlocked_inc( &object->refcount );
-    if (!object->num_pending_callbacks++)
-        list_add_tail( &pool->pool, &object->pool_entry );
+    if (!queued)
+    {
+        interlocked_inc( &object->refcount );
+        if (!object->num_pending_callbacks++)
+            list_add_tail( &pool->pool, &object->pool_entry );
+    }
 
     /* Count how often the object was signaled. */
     if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
@@ -2143,18 +2188,146 @@ static BOOL tp_object_release( struct threadpool_object *object )
     return TRUE;
 }
 
+/***********************************************************************
+ *           tp_object_execute    (internal)
+ *
+ * Executes the callback of a threadpool object and its cleanup tasks.
+ */
+static void tp_object_execute( struct threadpool_object *object, TP_WAIT_RESULT wait_result,
+                               struct threadpool_instance *instance )
+{
+    TP_CALLBACK_INSTANCE *callback_instance;
+    NTSTATUS status;
+
+    /* Initialize threadpool instance struct. */
+    callback_instance = (TP_CALLBACK_INSTANCE *)instance;
+    instance->object                    = object;
+    instance->threadid                  = GetCurrentThreadId();
+    instance->associated                = TRUE;
+    instance->may_run_long              = object->may_run_long;
+    instance->cleanup.critical_section  = NULL;
+    instance->cleanup.mutex             = NULL;
+    instance->cleanup.semaphore         = NULL;
+    instance->cleanup.semaphore_count   = 0;
+    instance->cleanup.event             = NULL;
+    instance->cleanup.library           = NULL;
+
+    switch (object->type)
+    {
+        case TP_OBJECT_TYPE_SIMPLE:
+        {
+            TRACE( "executing simple callback %p(%p, %p)\n",
+                   object->u.simple.callback, callback_instance, object->userdata );
+            object->u.simple.callback( callback_instance, object->userdata );
+            TRACE( "callback %p returned\n", object->u.simple.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_WORK:
+        {
+            TRACE( "executing work callback %p(%p, %p, %p)\n",
+                   object->u.work.callback, callback_instance, object->userdata, object );
+            object->u.work.callback( callback_instance, object->userdata, (TP_WORK *)object );
+            TRACE( "callback %p returned\n", object->u.work.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_TIMER:
+        {
+            TRACE( "executing timer callback %p(%p, %p, %p)\n",
+                   object->u.timer.callback, callback_instance, object->userdata, object );
+            object->u.timer.callback( callback_instance, object->userdata, (TP_TIMER *)object );
+            TRACE( "callback %p returned\n", object->u.timer.callback );
+            break;
+        }
+
+        case TP_OBJECT_TYPE_WAIT:
+        {
+            TRACE( "executing wait callback %p(%p, %p, %p, %u)\n",
+                   object->u.wait.callback, callback_instance, object->userdata, object, wait_result );
+            object->u.wait.callback( callback_instance, object->userdata, (TP_WAIT *)object, wait_result );
+            TRACE( "callback %p returned\n", object->u.wait.callback );
+            break;
+        }
+
+        default:
+            assert(0);
+            break;
+    }
+
+    /* Execute finalization callback. */
+    if (object->finalization_callback)
+    {
+        TRACE( "executing finalization callback %p(%p, %p)\n",
+               object->finalization_callback, callback_instance, object->userdata );
+        object->finalization_callback( callback_instance, object->userdata );
+        TRACE( "callback %p returned\n", object->finalization_callback );
+    }
+
+    /* Execute cleanup tasks. */
+    if (instance->cleanup.critical_section)
+    {
+        RtlLeaveCriticalSection( instance->cleanup.critical_section );
+    }
+    if (instance->cleanup.mutex)
+    {
+        status = NtReleaseMutant( instance->cleanup.mutex, NULL );
+        if (status != STATUS_SUCCESS) return;
+    }
+    if (instance->cleanup.semaphore)
+    {
+        status = NtReleaseSemaphore( instance->cleanup.semaphore, instance->cleanup.semaphore_count, NULL );
+        if (status != STATUS_SUCCESS) return;
+    }
+    if (instance->cleanup.event)
+    {
+        status = NtSetEvent( instance->cleanup.event, NULL );
+        if (status != STATUS_SUCCESS) return;
+    }
+    if (instance->cleanup.library)
+    {
+        LdrUnloadDll( instance->cleanup.library );
+    }
+}
+
+/***********************************************************************
+ *           tp_queue_execute    (internal)
+ *
+ * Executes the simple callbacks from the local queues, without taking the
+ * pool lock. Nobody can wait for these objects, so their counters are only
+ * kept up to date for the instance functions.
+ */
+static void tp_queue_execute( struct threadpool *pool )
+{
+    struct threadpool_instance instance;
+    struct threadpool_object *object;
+
+    while (!list_head( &pool->pool ) && (object = tp_queue_pop( pool )))
+    {
+        object->num_associated_callbacks++;
+        object->num_running_callbacks++;
+        interlocked_inc( &pool->num_busy_workers );
+
+        tp_object_execute( object, 0, &instance );
+
+        interlocked_dec( &pool->num_busy_workers );
+        object->num_running_callbacks--;
+        if (instance.associated) object->num_associated_callbacks--;
+        tp_object_release( object );
+    }
+}
+
 /***********************************************************************
  *           threadpool_worker_proc    (internal)
  */
 static void CALLBACK threadpool_worker_proc( void *param )
 {
-    TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
     struct threadpool *pool = param;
     TP_WAIT_RESULT wait_result = 0;
     LARGE_INTEGER timeout;
     struct list *ptr;
-    NTSTATUS status;
+    int spin;
 
     TRACE( "starting worker thread for pool %p\n", pool );
 
@@ -2182,102 +2355,13 @@ static void CALLBACK threadpool_worker_proc( void *param )
             /* Leave critical section and do the actual callback. */
             object->num_associated_callbacks++;
             object->num_running_callbacks++;
-            pool->num_busy_workers++;
+            interlocked_inc( &pool->num_busy_workers );
             RtlLeaveCriticalSection( &pool->cs );
 
-            /* Initialize threadpool instance struct. */
-            callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
-            instance.object                     = object;
-            instance.threadid                   = GetCurrentThreadId();
-            instance.associated                 = TRUE;
-            instance.may_run_long               = object->may_run_long;
-            instance.cleanup.critical_section   = NULL;
-            instance.cleanup.mutex              = NULL;
-            instance.cleanup.semaphore          = NULL;
-            instance.cleanup.semaphore_count    = 0;
-            instance.cleanup.event              = NULL;
-            instance.cleanup.library            = NULL;
-
-            switch (object->type)
-            {
-                case TP_OBJECT_TYPE_SIMPLE:
-                {
-                    TRACE( "executing simple callback %p(%p, %p)\n",
-                           object->u.simple.callback, callback_instance, object->userdata );
-                    object->u.simple.callback( callback_instance, object->userdata );
-                    TRACE( "callback %p returned\n", object->u.simple.callback );
-                    break;
-                }
-
-                case TP_OBJECT_TYPE_WORK:
-                {
-                    TRACE( "executing work callback %p(%p, %p, %p)\n",
-                           object->u.work.callback, callback_instance, object->userdata, object );
-                    object->u.work.callback( callback_instance, object->userdata, (TP_WORK *)object );
-                    TRACE( "callback %p returned\n", object->u.work.callback );
-                    break;
-                }
-
-                case TP_OBJECT_TYPE_TIMER:
-                {
-                    TRACE( "executing timer callback %p(%p, %p, %p)\n",
-                           object->u.timer.callback, callback_instance, object->userdata, object );
-                    object->u.timer.callback( callback_instance, object->userdata, (TP_TIMER *)object );
-                    TRACE( "callback %p returned\n", object->u.timer.callback );
-                    break;
-                }
-
-                case TP_OBJECT_TYPE_WAIT:
-                {
-                    TRACE( "executing wait callback %p(%p, %p, %p, %u)\n",
-                           object->u.wait.callback, callback_instance, object->userdata, object, wait_result );
-                    object->u.wait.callback( callback_instance, object->userdata, (TP_WAIT *)object, wait_result );
-                    TRACE( "callback %p returned\n", object->u.wait.callback );
-                    break;
-                }
-
-                default:
-                    assert(0);
-                    break;
-            }
-
-            /* Execute finalization callback. */
-            if (object->finalization_callback)
-            {
-                TRACE( "executing finalization callback %p(%p, %p)\n",
-                       object->finalization_callback, callback_instance, object->userdata );
-                object->finalization_callback( callback_instance, object->userdata );
-                TRACE( "callback %p returned\n", object->finalization_callback );
-            }
-
-            /* Execute cleanup tasks. */
-            if (instance.cleanup.critical_section)
-            {
-                RtlLeaveCriticalSection( instance.cleanup.critical_section );
-            }
-            if (instance.cleanup.mutex)
-            {
-                status = NtReleaseMutant( instance.cleanup.mutex, NULL );
-                if (status != STATUS_SUCCESS) goto skip_cleanup;
-            }
-            if (instance.cleanup.semaphore)
-            {
-                status = NtReleaseSemaphore( instance.cleanup.semaphore, instance.cleanup.semaphore_count, NULL );
-                if (status != STATUS_SUCCESS) goto skip_cleanup;
-            }
-            if (instance.cleanup.event)
-            {
-                status = NtSetEvent( instance.cleanup.event, NULL );
-                if (status != STATUS_SUCCESS) goto skip_cleanup;
-            }
-            if (instance.cleanup.library)
-            {
-                LdrUnloadDll( instance.cleanup.library );
-            }
+            tp_object_execute( object, wait_result, &instance );
 
-        skip_cleanup:
             RtlEnterCriticalSection( &pool->cs );
-            pool->num_busy_workers--;
+            interlocked_dec( &pool->num_busy_workers );
 
             object->num_running_callbacks--;
             if (!object->num_pending_callbacks && !object->num_running_callbacks)
@@ -2293,6 +2377,29 @@ static void CALLBACK threadpool_worker_proc( void *param )
             tp_object_release( object );
         }
 
+        /* Process the local queues, and keep spinning on them for a while so
+         * that simple callbacks can be submitted without waking us up. */
+        RtlLeaveCriticalSection( &pool->cs );
+        interlocked_inc( &pool->num_spinning );
+        for (spin = 0; spin < THREADPOOL_SPIN_COUNT && !list_head( &pool->pool ); spin++)
+        {
+            if (!pool->num_queued)
+            {
+                NtYieldExecution();
+                continue;
+            }
+            interlocked_dec( &pool->num_spinning );
+            tp_queue_execute( pool );
+            interlocked_inc( &pool->num_spinning );
+            spin = 0;
+        }
+        interlocked_dec( &pool->num_spinning );
+        RtlEnterCriticalSection( &pool->cs );
+
+        /* A submitter that has seen us spinning doesn't wake us up. */
+        if (pool->num_queued || list_head( &pool->pool ))
+            continue;
+
         /* Shutdown worker thread if requested. */
         if (pool->shutdown)
             break;
@@ -2304,7 +2411,8 @@ static void CALLBACK threadpool_worker_proc( void *param )
          * can be terminated. */
         timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
         if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !list_head( &pool->pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
+            !list_head( &pool->pool ) && !pool->num_queued &&
+            (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
             break;
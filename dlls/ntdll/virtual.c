@@ -51,6 +51,7 @@
 #include "wine/server.h"
 #include "wine/exception.h"
 #include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -65,6 +66,7 @@ WINE_DECLARE_DEBUG_CHANNEL(module);
 struct file_view
 {
     struct list   entry;       /* Entry in global view list */
+    struct wine_rb_entry tree_entry; /* Entry in global view tree, indexed by base address */
     void         *base;        /* Base address */
     size_t        size;        /* Size in bytes */
     HANDLE        mapping;     /* Handle to the file mapping */
@@ -96,6 +98,7 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 };
 
 static struct list views_list = LIST_INIT(views_list);
+static struct wine_rb_tree views_tree;
 
 static RTL_CRITICAL_SECTION csVirtual;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -150,6 +153,39 @@ static BOOL use_locks;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
 
 
+static void *views_tree_alloc( size_t size )
+{
+    return RtlAllocateHeap( virtual_heap, 0, size );
+}
+
+static void *views_tree_realloc( void *ptr, size_t size )
+{
+    return RtlReAllocateHeap( virtual_heap, 0, ptr, size );
+}
+
+static void views_tree_free( void *ptr )
+{
+    RtlFreeHeap( virtual_heap, 0, ptr );
+}
+
+static int compare_view_base( const void *addr, const struct wine_rb_entry *entry )
+{
+    const struct file_view *view = WINE_RB_ENTRY_VALUE( entry, const struct file_view, tree_entry );
+
+    if (addr < view->base) return -1;
+    if (addr > view->base) return 1;
+    return 0;
+}
+
+static const struct wine_rb_functions views_tree_funcs =
+{
+    views_tree_alloc,
+    views_tree_realloc,
+    views_tree_free,
+    compare_view_base,
+};
+
+
 /***********************************************************************
  *           VIRTUAL_GetProtStr
  */
@@ -255,15 +291,20 @@ static void VIRTUAL_Dump(void)
  */
 static struct file_view *VIRTUAL_FindView( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct wine_rb_entry *ptr = views_tree.root;
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    while (ptr)
     {
-        if (view->base > addr) break;  /* no matching view */
-        if ((const char *)view->base + view->size <= (const char *)addr) continue;
-        if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
-        if ((const char *)addr + size < (const char *)addr) break; /* overflow */
-        return view;
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+
+        if (view->base > addr) ptr = ptr->left;
+        else if ((const char *)view->base + view->size <= (const char *)addr) ptr = ptr->right;
+        else
+        {
+            if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
+            if ((const char *)addr + size < (const char *)addr) break; /* overflow */
+            return view;
+        }
     }
     return NULL;
 }
@@ -280,6 +321,56 @@ static inline UINT_PTR get_mask( ULONG zero_bits )
 }
 
 
+/***********************************************************************
+ *           find_view_after
+ *
+ * Find the first view that ends above the specified address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_after( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *view, *ret = NULL;
+
+    while (ptr)
+    {
+        view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+        if ((const char *)view->base + view->size <= (const char *)addr) ptr = ptr->right;
+        else
+        {
+            ret = view;
+            ptr = ptr->left;
+        }
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           find_view_before
+ *
+ * Find the last view that starts below the specified address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_before( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *view, *ret = NULL;
+
+    while (ptr)
+    {
+        view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+        if (view->base >= addr) ptr = ptr->left;
+        else
+        {
+            ret = view;
+            ptr = ptr->right;
+        }
+    }
+    return ret;
+}
+
+
 /***********************************************************************
  *           find_view_range
  *
@@ -288,13 +379,9 @@ static inline UINT_PTR get_mask( ULONG zero_bits )
  */
 static struct file_view *find_view_range( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_after( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if ((const char *)view->base >= (const char *)addr + size) break;
-        if ((const char *)view->base + view->size > (const char *)addr) return view;
-    }
+    if (view && (const char *)view->base < (const char *)addr + size) return view;
     return NULL;
 }
 
@@ -307,6 +394,7 @@ static struct file_view *find_view_range( const void *addr, size_t size )
  */
 static void *find_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
+    struct file_view *first;
     struct list *ptr;
     void *start;
 
@@ -315,7 +403,10 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)end - size, mask );
         if (start >= end || start < base) return NULL;
 
-        for (ptr = views_list.prev; ptr != &views_list; ptr = ptr->prev)
+        /* views starting above the end of the range can be skipped */
+        if (!(first = find_view_before( (char *)start + size ))) return start;
+
+        for (ptr = &first->entry; ptr != &views_list; ptr = ptr->prev)
         {
             struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
 
@@ -331,7 +422,10 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)base + mask, mask );
         if (start >= end || (char *)end - (char *)start < size) return NULL;
 
-        for (ptr = views_list.next; ptr != &views_list; ptr = ptr->next)
+        /* views ending below the start of the range can be skipped */
+        if (!(first = find_view_after( start ))) return start;
+
+        for (ptr = &first->entry; ptr != &views_list; ptr = ptr->next)
         {
             struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
 
@@ -436,6 +530,7 @@ static inline void unmap_area( void *addr, size_t size )
 static void delete_view( struct file_view *view ) /* [in] View */
 {
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
+    wine_rb_remove( &views_tree, view->base );
     list_remove( &view->entry );
     if (view->mapping) close_handle( view->mapping );
     RtlFreeHeap( virtual_heap, 0, view );
@@ -449,7 +544,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
  */
 static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t size, unsigned int vprot )
 {
-    struct file_view *view;
+    struct file_view *view, *prev;
     struct list *ptr;
     int unix_prot = VIRTUAL_GetUnixProt( vprot );
 
@@ -471,14 +566,10 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->protect = vprot;
     memset( view->prot, vprot, size >> page_shift );
 
-    /* Insert it in the linked list */
+    /* Insert it in the linked list, after the last view starting at or below it */
 
-    LIST_FOR_EACH( ptr, &views_list )
-    {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if (next->base > base) break;
-    }
-    list_add_before( ptr, &view->entry );
+    if ((prev = find_view_before( (char *)base + 1 ))) list_add_after( &prev->entry, &view->entry );
+    else list_add_head( &views_list, &view->entry );
 
     /* Check for overlapping views. This can happen if the previous view
      * was a system view that got unmapped behind our back. In that case
@@ -509,6 +600,16 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
         }
     }
 
+    /* Insert it in the tree, now that overlapping views are gone */
+
+    if (wine_rb_put( &views_tree, view->base, &view->tree_entry ))
+    {
+        FIXME( "out of memory in virtual heap for %p-%p\n", base, (char *)base + size );
+        list_remove( &view->entry );
+        RtlFreeHeap( virtual_heap, 0, view );
+        return STATUS_NO_MEMORY;
+    }
+
     *view_ret = view;
     VIRTUAL_DEBUG_DUMP_VIEW( view );
 
@@ -1060,7 +1161,8 @@ static NTSTATUS stat_mapping_file( struct file_view *view, struct stat *st )
  * Map an executable (PE format) image into memory.
  */
 static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_size, SIZE_T mask,
-                           SIZE_T header_size, int shared_fd, HANDLE dup_mapping, unsigned int map_vprot, PVOID *addr_ptr )
+                           SIZE_T header_size, int shared_fd, int image_fd, HANDLE dup_mapping,
+                           unsigned int map_vprot, PVOID *addr_ptr )
 {
     IMAGE_DOS_HEADER *dos;
     IMAGE_NT_HEADERS *nt;
@@ -1213,14 +1315,31 @@ static NTSTATUS map_image( HANDLE hmapping, int fd, char *base, SIZE_T total_siz
 
         if (!sec->PointerToRawData || !file_size) continue;
 
-        /* Note: if the section is not aligned properly map_file_into_view will magically
-         *       fall back to read(), so we don't need to check anything here.
-         */
         end = file_start + file_size;
         if (sec->PointerToRawData >= st.st_size ||
             end > ((st.st_size + sector_align) & ~sector_align) ||
-            end < file_start ||
-            map_file_into_view( view, fd, sec->VirtualAddress, file_size, file_start,
+            end < file_start)
+        {
+            ERR_(module)( "Could not map section %.8s, file probably truncated\n", sec->Name );
+            goto error;
+        }
+
+        /* the server laid out the misaligned sections in a shared file, already zero-padded */
+        if (image_fd != -1 && (file_start & page_mask))
+        {
+            if (map_file_into_view( view, image_fd, sec->VirtualAddress, file_size, sec->VirtualAddress,
+                                    VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY, FALSE ) != STATUS_SUCCESS)
+            {
+                ERR_(module)( "Could not map section %.8s from image layout\n", sec->Name );
+                goto error;
+            }
+            continue;
+        }
+
+        /* Note: if the section is not aligned properly map_file_into_view will magically
+         *       fall back to read(), so we don't need to check anything here.
+         */
+        if (map_file_into_view( view, fd, sec->VirtualAddress, file_size, file_start,
                                 VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY,
                                 !dup_mapping ) != STATUS_SUCCESS)
         {
@@ -1368,6 +1487,7 @@ void virtual_init(void)
     const char *preload;
     void *heap_base;
     size_t size;
+    int ret;
     struct file_view *heap_view;
 
 #if !defined(__i386__) && !defined(__x86_64__)
@@ -1396,6 +1516,8 @@ void virtual_init(void)
     assert( heap_base != (void *)-1 );
     virtual_heap = RtlCreateHeap( HEAP_NO_SERIALIZE, heap_base, VIRTUAL_HEAP_SIZE,
                                   VIRTUAL_HEAP_SIZE, NULL, NULL );
+    ret = wine_rb_init( &views_tree, &views_tree_funcs );
+    assert( !ret );
     create_view( &heap_view, heap_base, VIRTUAL_HEAP_SIZE, VPROT_COMMITTED | VPROT_READ | VPROT_WRITE );
 
     /* make the DOS area accessible (except the low 64K) to hide bugs in broken apps like Excel 2003 */
@@ -2606,11 +2728,12 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
     ACCESS_MASK access;
     SIZE_T size, mask = get_mask( zero_bits );
     int unix_handle = -1, needs_close;
+    int shared_fd = -1, shared_needs_close = 0, image_fd = -1, image_needs_close = 0;
     unsigned int map_vprot, vprot;
     void *base;
     struct file_view *view;
     DWORD header_size;
-    HANDLE dup_mapping, shared_file;
+    HANDLE dup_mapping, shared_file, image_file;
     LARGE_INTEGER offset;
     sigset_t sigset;
 
@@ -2692,6 +2815,7 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
         header_size = reply->header_size;
         dup_mapping = wine_server_ptr_handle( reply->mapping );
         shared_file = wine_server_ptr_handle( reply->shared_file );
+        image_file  = wine_server_ptr_handle( reply->image_file );
         if ((ULONG_PTR)base != reply->base) base = NULL;
     }
     SERVER_END_REQ;
@@ -2709,24 +2833,21 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
             goto done;
         }
         if (shared_file)
+            res = server_get_unix_fd( shared_file, FILE_READ_DATA|FILE_WRITE_DATA,
+                                      &shared_fd, &shared_needs_close, NULL, NULL );
+        if (!res && image_file &&
+            server_get_unix_fd( image_file, FILE_READ_DATA, &image_fd, &image_needs_close, NULL, NULL ))
+            image_fd = -1;  /* not fatal, fall back to reading the sections */
+        if (!res)
         {
-            int shared_fd, shared_needs_close;
-
-            if ((res = server_get_unix_fd( shared_file, FILE_READ_DATA|FILE_WRITE_DATA,
-                                           &shared_fd, &shared_needs_close, NULL, NULL ))) goto done;
             res = map_image( handle, unix_handle, base, size, mask, header_size,
-                             shared_fd, dup_mapping, map_vprot, addr_ptr );
-            if (shared_needs_close) close( shared_fd );
-            NtClose( shared_file );
+                             shared_fd, image_fd, dup_mapping, map_vprot, addr_ptr );
+            dup_mapping = 0;  /* now owned by the view */
+            if (res >= 0) *size_ptr = size;
         }
-        else
-        {
-            res = map_image( handle, unix_handle, base, size, mask, header_size,
-                             -1, dup_mapping, map_vprot, addr_ptr );
-        }
-        if (needs_close) close( unix_handle );
-        if (res >= 0) *size_ptr = size;
-        return res;
+        if (shared_needs_close) close( shared_fd );
+        if (image_needs_close) close( image_fd );
+        goto done;
     }
 
     res = STATUS_INVALID_PARAMETER;
@@ -2786,6 +2907,8 @@ NTSTATUS WINAPI NtMapViewOfSection( HANDLE handle, HANDLE process, PVOID *addr_p
 
 done:
     if (dup_mapping) NtClose( dup_mapping );
+    if (shared_file) NtClose( shared_file );
+    if (image_file) NtClose( image_file );
     if (needs_close) close( unix_handle );
     return res;
 }
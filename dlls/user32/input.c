@@ -422,6 +422,7 @@ SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
  */
 DWORD WINAPI GetQueueStatus( UINT flags )
 {
+    struct user_thread_info *thread_info = get_user_thread_info();
     DWORD ret;
 
     if (flags & ~(QS_ALLINPUT | QS_ALLPOSTMESSAGE | QS_SMRESULT))
@@ -439,6 +440,9 @@ DWORD WINAPI GetQueueStatus( UINT flags )
         ret = MAKELONG( reply->changed_bits & flags, reply->wake_bits & flags );
     }
     SERVER_END_REQ;
+    /* posted messages already retrieved from the server are still in the queue */
+    if (thread_info->prefetched && thread_info->prefetched->count)
+        ret |= MAKELONG( 0, (QS_POSTMESSAGE | QS_ALLPOSTMESSAGE) & flags );
     return ret;
 }
 
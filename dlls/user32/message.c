@@ -56,6 +56,10 @@ WINE_DECLARE_DEBUG_CHANNEL(key);
 
 #define MAX_PACK_COUNT 4
 
+/* max time in ms prefetched posted messages are kept before going back to the server,
+ * so that the server sees messages being retrieved and the queue doesn't look hung */
+#define PREFETCH_TIMEOUT 100
+
 /* the various structures that can be sent in messages, in platform-independent layout */
 struct packed_CREATESTRUCTW
 {
@@ -2720,6 +2724,143 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
 }
 
 
+/***********************************************************************
+ *           match_window_filter
+ *
+ * Check if a message window matches the window filter of a peek request.
+ */
+static BOOL match_window_filter( HWND hwnd, HWND msg_hwnd )
+{
+    if (!hwnd) return TRUE;
+    if (hwnd == (HWND)-1 || hwnd == (HWND)1) return !msg_hwnd;
+    if (!msg_hwnd) return FALSE;
+    hwnd = WIN_GetFullHandle( hwnd );
+    return (msg_hwnd == hwnd || IsChild( hwnd, msg_hwnd ));
+}
+
+
+/***********************************************************************
+ *           get_prefetched_message
+ *
+ * Retrieve a posted message that has already been removed from the server queue.
+ * These are older than any posted message still in the server queue.
+ */
+static BOOL get_prefetched_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags )
+{
+    struct prefetched_messages *prefetched = get_user_thread_info()->prefetched;
+    int i;
+
+    if (!prefetched || !prefetched->count) return FALSE;
+    if (HIWORD(flags) && !(HIWORD(flags) & QS_POSTMESSAGE)) return FALSE;
+    /* sent messages are processed before any posted message is returned */
+    if (prefetched->shared->wake_bits & QS_SENDMESSAGE) return FALSE;
+    if ((int)(GetTickCount() - prefetched->expire) >= 0) return FALSE;
+
+    for (i = 0; i < prefetched->count; i++)
+    {
+        MSG *ptr = &prefetched->msgs[i];
+        BOOL destroyed = ptr->hwnd && !IsWindow( ptr->hwnd );
+
+        if (!destroyed)
+        {
+            if (ptr->message < first || ptr->message > last) continue;
+            if (!match_window_filter( hwnd, ptr->hwnd )) continue;
+            *msg = *ptr;
+            if (!(flags & PM_REMOVE)) return TRUE;
+        }
+        /* remove it, messages for destroyed windows are discarded like in the server queue */
+        prefetched->count--;
+        memmove( ptr, ptr + 1, (prefetched->count - i) * sizeof(*ptr) );
+        if (!destroyed) return TRUE;
+        i--;
+    }
+    return FALSE;
+}
+
+
+/***********************************************************************
+ *           alloc_prefetched_messages
+ *
+ * Allocate the buffer for prefetched messages, along with a view of the server
+ * queue state to notice sent messages without a server call. Messages are only
+ * prefetched when the view is available.
+ */
+static struct prefetched_messages *alloc_prefetched_messages(void)
+{
+    struct prefetched_messages *prefetched;
+    HANDLE mapping = 0;
+
+    if (!(prefetched = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*prefetched) ))) return NULL;
+
+    SERVER_START_REQ( get_msg_queue_shared )
+    {
+        if (!wine_server_call( req )) mapping = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (mapping)
+    {
+        prefetched->shared = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+        CloseHandle( mapping );
+    }
+    return prefetched;
+}
+
+
+/***********************************************************************
+ *           store_prefetched_messages
+ */
+static void store_prefetched_messages( const struct posted_msg_data *data, UINT count )
+{
+    struct prefetched_messages *prefetched = get_user_thread_info()->prefetched;
+    UINT i;
+
+    prefetched->expire = GetTickCount() + PREFETCH_TIMEOUT;
+    for (i = 0; i < count; i++)
+    {
+        MSG *msg = &prefetched->msgs[prefetched->count++];
+
+        msg->hwnd    = wine_server_ptr_handle( data[i].win );
+        msg->message = data[i].msg;
+        msg->wParam  = data[i].wparam;
+        msg->lParam  = data[i].lparam;
+        msg->time    = data[i].time;
+        msg->pt.x    = data[i].x;
+        msg->pt.y    = data[i].y;
+    }
+}
+
+
+/***********************************************************************
+ *           return_prefetched_messages
+ *
+ * Empty the prefetched messages, to give them back to the server with the next request.
+ */
+static UINT return_prefetched_messages( struct posted_msg_data *data )
+{
+    struct prefetched_messages *prefetched = get_user_thread_info()->prefetched;
+    UINT i, count;
+
+    if (!prefetched) return 0;
+
+    for (i = 0; i < prefetched->count; i++)
+    {
+        const MSG *msg = &prefetched->msgs[i];
+
+        data[i].win    = wine_server_user_handle( msg->hwnd );
+        data[i].msg    = msg->message;
+        data[i].wparam = msg->wParam;
+        data[i].lparam = msg->lParam;
+        data[i].x      = msg->pt.x;
+        data[i].y      = msg->pt.y;
+        data[i].time   = msg->time;
+        data[i].__pad  = 0;
+    }
+    count = prefetched->count;
+    prefetched->count = 0;
+    return count;
+}
+
+
 /***********************************************************************
  *           peek_message
  *
@@ -2733,7 +2874,8 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
     struct received_message_info info, *old_info;
     unsigned int hw_id = 0;  /* id of previous hardware message */
     void *buffer;
-    size_t buffer_size = 256;
+    size_t buffer_size = 1024;  /* large enough for MAX_PREFETCHED_MESSAGES */
+    BOOL can_prefetch;
 
     if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return FALSE;
 
@@ -2744,7 +2886,32 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
     {
         NTSTATUS res;
         size_t size = 0;
+        UINT prefetch = 0, prefetched = 0, requeue;
         const message_data_t *msg_data = buffer;
+        struct posted_msg_data requeue_data[MAX_PREFETCHED_MESSAGES];
+
+        /* posted messages already retrieved come first */
+        if (get_prefetched_message( &info.msg, hwnd, first, last, flags ))
+        {
+            *msg = info.msg;
+            thread_info->GetMessagePosVal = MAKELONG( info.msg.pt.x, info.msg.pt.y );
+            thread_info->GetMessageTimeVal = info.msg.time;
+            thread_info->GetMessageExtraInfoVal = 0;
+            HeapFree( GetProcessHeap(), 0, buffer );
+            HOOK_CallHooks( WH_GETMESSAGE, HC_ACTION, flags & PM_REMOVE, (LPARAM)msg, TRUE );
+            return TRUE;
+        }
+
+        /* the server has to see the whole queue to pick the right message */
+        requeue = return_prefetched_messages( requeue_data );
+
+        /* fetch several posted messages at once when draining the whole queue */
+        can_prefetch = (flags & PM_REMOVE) && !hwnd && !first && last == ~0U &&
+                       (!HIWORD(flags) || (HIWORD(flags) & QS_POSTMESSAGE));
+        if (can_prefetch && !thread_info->prefetched)
+            thread_info->prefetched = alloc_prefetched_messages();
+        if (can_prefetch && thread_info->prefetched && thread_info->prefetched->shared)
+            prefetch = MAX_PREFETCHED_MESSAGES - thread_info->prefetched->count;
 
         SERVER_START_REQ( get_message )
         {
@@ -2755,10 +2922,13 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
             req->hw_id     = hw_id;
             req->wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
             req->changed_mask = changed_mask;
+            req->prefetch  = prefetch;
+            wine_server_add_data( req, requeue_data, requeue * sizeof(requeue_data[0]) );
             wine_server_set_reply( req, buffer, buffer_size );
             if (!(res = wine_server_call( req )))
             {
                 size = wine_server_reply_size( reply );
+                prefetched       = reply->prefetched;
                 info.type        = reply->type;
                 info.msg.hwnd    = wine_server_ptr_handle( reply->win );
                 info.msg.message = reply->msg;
@@ -2787,6 +2957,12 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
             continue;
         }
 
+        if (prefetched)
+        {
+            store_prefetched_messages( msg_data->posted, prefetched );
+            size = 0;
+        }
+
         TRACE( "got type %d msg %x (%s) hwnd %p wp %lx lp %lx\n",
                info.type, info.msg.message,
                (info.type == MSG_WINEVENT) ? "MSG_WINEVENT" : SPY_GetMsgName(info.msg.message, info.msg.hwnd),
@@ -4141,6 +4317,11 @@ DWORD WINAPI MsgWaitForMultipleObjectsEx( DWORD count, const HANDLE *pHandles,
         return WAIT_FAILED;
     }
 
+    /* posted messages that were already retrieved from the server are still available input */
+    if ((flags & MWMO_INPUTAVAILABLE) && (mask & (QS_POSTMESSAGE | QS_ALLPOSTMESSAGE)) &&
+        get_user_thread_info()->prefetched && get_user_thread_info()->prefetched->count)
+        return WAIT_OBJECT_0 + count;
+
     /* add the queue to the handle list */
     for (i = 0; i < count; i++) handles[i] = pHandles[i];
     handles[count] = get_server_queue_handle();
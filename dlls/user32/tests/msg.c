@@ -10696,6 +10696,110 @@ static void test_PeekMessage3(void)
     flush_events();
 }
 
+static UINT buffered_sent_message;
+static UINT buffered_sent_count;
+
+static LRESULT WINAPI buffered_msg_wnd_proc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
+{
+    if (message == WM_USER + 100 || message == WM_USER + 101)
+    {
+        buffered_sent_message = message;
+        buffered_sent_count++;
+        return 0xdead;
+    }
+    return DefWindowProcA(hwnd, message, wp, lp);
+}
+
+static DWORD WINAPI send_notify_thread(void *param)
+{
+    BOOL ret = SendNotifyMessageA(param, WM_USER + 100, 0, 0);
+    ok(ret, "SendNotifyMessageA failed, error %u\n", GetLastError());
+    return 0;
+}
+
+static DWORD WINAPI send_timeout_thread(void *param)
+{
+    DWORD_PTR result = 0;
+    LRESULT ret = SendMessageTimeoutA(param, WM_USER + 101, 0, 0, SMTO_NORMAL, 5000, &result);
+    ok(ret, "SendMessageTimeoutA failed, error %u\n", GetLastError());
+    ok(result == 0xdead, "got result %lx\n", result);
+    return 0;
+}
+
+/* messages retrieved ahead of time must not change what the queue looks like */
+static void test_PeekMessage_posted_order(void)
+{
+    HWND hwnd;
+    HANDLE thread;
+    DWORD status, ret;
+    BOOL res;
+    MSG msg;
+    int i;
+
+    hwnd = CreateWindowA("static", "posted order", WS_POPUP, 0, 0, 10, 10, NULL, NULL, NULL, NULL);
+    ok(hwnd != NULL, "expected hwnd != NULL\n");
+    SetWindowLongPtrA(hwnd, GWLP_WNDPROC, (LONG_PTR)buffered_msg_wnd_proc);
+    flush_events();
+
+    for (i = 0; i < 6; i++) PostMessageA(hwnd, WM_USER + i, 0, 0);
+    res = GetMessageA(&msg, NULL, 0, 0);
+    ok(res && msg.message == WM_USER, "msg.message = %04x instead of WM_USER\n", msg.message);
+
+    /* the queue still holds the other posted messages */
+    status = GetQueueStatus(QS_POSTMESSAGE);
+    ok(HIWORD(status) & QS_POSTMESSAGE, "GetQueueStatus returned %08x\n", status);
+    ret = MsgWaitForMultipleObjectsEx(0, NULL, 0, QS_POSTMESSAGE, MWMO_INPUTAVAILABLE);
+    ok(ret == WAIT_OBJECT_0, "MsgWaitForMultipleObjectsEx returned %x\n", ret);
+
+    /* filters pick later messages without disturbing the order of the others */
+    res = PeekMessageA(&msg, NULL, WM_USER + 2, WM_USER + 2, PM_REMOVE);
+    ok(res && msg.message == WM_USER + 2, "msg.message = %04x instead of WM_USER + 2\n", msg.message);
+    res = PeekMessageA(&msg, NULL, WM_USER + 10, WM_USER + 20, PM_REMOVE);
+    ok(!res, "PeekMessageA returned message %04x\n", msg.message);
+    res = PeekMessageA(&msg, hwnd, 0, 0, PM_NOREMOVE);
+    ok(res && msg.message == WM_USER + 1, "msg.message = %04x instead of WM_USER + 1\n", msg.message);
+    res = PeekMessageA(&msg, (HWND)-1, 0, 0, PM_REMOVE);
+    ok(!res, "PeekMessageA returned message %04x\n", msg.message);
+
+    /* sent messages are processed before the next posted message is returned */
+    buffered_sent_count = 0;
+    thread = CreateThread(NULL, 0, send_notify_thread, hwnd, 0, NULL);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    res = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+    ok(res && msg.message == WM_USER + 1, "msg.message = %04x instead of WM_USER + 1\n", msg.message);
+    ok(buffered_sent_count == 1, "got %u sent messages\n", buffered_sent_count);
+    ok(buffered_sent_message == WM_USER + 100, "got sent message %04x\n", buffered_sent_message);
+
+    buffered_sent_count = 0;
+    thread = CreateThread(NULL, 0, send_timeout_thread, hwnd, 0, NULL);
+    for (i = 0; i < 100; i++)
+    {
+        if (HIWORD(GetQueueStatus(QS_SENDMESSAGE)) & QS_SENDMESSAGE) break;
+        Sleep(10);
+    }
+    ok(i < 100, "sent message never arrived\n");
+    res = GetMessageA(&msg, NULL, 0, 0);
+    ok(res && msg.message == WM_USER + 3, "msg.message = %04x instead of WM_USER + 3\n", msg.message);
+    ok(buffered_sent_count == 1, "got %u sent messages\n", buffered_sent_count);
+    ok(buffered_sent_message == WM_USER + 101, "got sent message %04x\n", buffered_sent_message);
+    ret = WaitForSingleObject(thread, 5000);
+    ok(ret == WAIT_OBJECT_0, "thread still running\n");
+    CloseHandle(thread);
+
+    res = GetMessageA(&msg, NULL, 0, 0);
+    ok(res && msg.message == WM_USER + 4, "msg.message = %04x instead of WM_USER + 4\n", msg.message);
+    res = GetMessageA(&msg, NULL, 0, 0);
+    ok(res && msg.message == WM_USER + 5, "msg.message = %04x instead of WM_USER + 5\n", msg.message);
+    res = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+    ok(!res, "PeekMessageA returned message %04x\n", msg.message);
+    status = GetQueueStatus(QS_POSTMESSAGE);
+    ok(!(HIWORD(status) & QS_POSTMESSAGE), "GetQueueStatus returned %08x\n", status);
+
+    DestroyWindow(hwnd);
+    flush_events();
+}
+
 static INT_PTR CALLBACK wm_quit_dlg_proc(HWND hwnd, UINT message, WPARAM wp, LPARAM lp)
 {
     struct recvd_message msg;
@@ -14989,6 +15093,7 @@ START_TEST(msg)
     test_PeekMessage();
     test_PeekMessage2();
     test_PeekMessage3();
+    test_PeekMessage_posted_order();
     test_WaitForInputIdle( test_argv[0] );
     test_scrollwindowex();
     test_messages();
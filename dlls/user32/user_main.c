@@ -310,6 +310,9 @@ static void thread_detach(void)
     HeapFree( GetProcessHeap(), 0, thread_info->wmchar_data );
     HeapFree( GetProcessHeap(), 0, thread_info->key_state );
     HeapFree( GetProcessHeap(), 0, thread_info->rawinput );
+    if (thread_info->prefetched && thread_info->prefetched->shared)
+        UnmapViewOfFile( thread_info->prefetched->shared );
+    HeapFree( GetProcessHeap(), 0, thread_info->prefetched );
 
     exiting_thread_id = 0;
 }
@@ -188,12 +188,25 @@ struct user_thread_info
     HWND                          top_window;             /* Desktop window */
     HWND                          msg_window;             /* HWND_MESSAGE parent window */
     RAWINPUT                     *rawinput;
+    struct prefetched_messages   *prefetched;             /* Posted messages already removed from the server queue */
 };
 
 C_ASSERT( sizeof(struct user_thread_info) <= sizeof(((TEB *)0)->Win32ClientInfo) );
 
 extern INT global_key_state_counter DECLSPEC_HIDDEN;
 
+#define MAX_PREFETCHED_MESSAGES 16
+
+struct queue_shared_data;
+
+struct prefetched_messages
+{
+    UINT                          count;                  /* Number of pending messages */
+    DWORD                         expire;                 /* Tick count after which they go back to the server */
+    const struct queue_shared_data *shared;               /* Server queue state, to notice sent messages */
+    MSG                           msgs[MAX_PREFETCHED_MESSAGES]; /* Messages in queue order */
+};
+
 struct user_key_state_info
 {
     UINT                          time;                   /* Time of last key state refresh */
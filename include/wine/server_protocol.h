@@ -259,6 +259,16 @@ typedef struct
 } async_data_t;
 
 
+typedef struct
+{
+    apc_param_t     ckey;
+    apc_param_t     cvalue;
+    apc_param_t     information;
+    unsigned int    status;
+    int             __pad;
+} completion_msg_t;
+
+
 
 struct hardware_msg_data
 {
@@ -330,15 +340,34 @@ typedef union
     } hw;
 } hw_input_t;
 
+struct posted_msg_data
+{
+    user_handle_t   win;
+    unsigned int    msg;
+    lparam_t        wparam;
+    lparam_t        lparam;
+    int             x;
+    int             y;
+    unsigned int    time;
+    int             __pad;
+};
+
 typedef union
 {
     unsigned char            bytes[1];
     struct hardware_msg_data hardware;
     struct callback_msg_data callback;
     struct winevent_msg_data winevent;
+    struct posted_msg_data   posted[1];
 } message_data_t;
 
 
+struct queue_shared_data
+{
+    unsigned int    wake_bits;
+};
+
+
 typedef struct
 {
     WCHAR          ch;
@@ -2147,6 +2176,8 @@ struct get_mapping_info_reply
     client_ptr_t base;
     obj_handle_t mapping;
     obj_handle_t shared_file;
+    obj_handle_t image_file;
+    char __pad_44[4];
 };
 
 
@@ -2835,6 +2866,20 @@ struct get_msg_queue_reply
 
 
 
+struct get_msg_queue_shared_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_msg_queue_shared_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+
 struct set_queue_fd_request
 {
     struct request_header __header;
@@ -2969,6 +3014,9 @@ struct get_message_request
     unsigned int    hw_id;
     unsigned int    wake_mask;
     unsigned int    changed_mask;
+    unsigned int    prefetch;
+    /* VARARG(requeue,bytes); */
+    char __pad_44[4];
 };
 struct get_message_reply
 {
@@ -2983,7 +3031,9 @@ struct get_message_reply
     unsigned int    time;
     unsigned int    active_hooks;
     data_size_t     total;
+    unsigned int    prefetched;
     /* VARARG(data,message_data); */
+    char __pad_60[4];
 };
 
 
@@ -5020,6 +5070,19 @@ struct remove_completion_reply
 
 
 
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(msgs,completion_msgs); */
+};
+
+
+
 struct query_completion_request
 {
     struct request_header __header;
@@ -5407,6 +5470,7 @@ enum request
     REQ_empty_atom_table,
     REQ_init_atom_table,
     REQ_get_msg_queue,
+    REQ_get_msg_queue_shared,
     REQ_set_queue_fd,
     REQ_set_queue_mask,
     REQ_get_queue_status,
@@ -5533,6 +5597,7 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
@@ -5680,6 +5745,7 @@ union generic_request
     struct empty_atom_table_request empty_atom_table_request;
     struct init_atom_table_request init_atom_table_request;
     struct get_msg_queue_request get_msg_queue_request;
+    struct get_msg_queue_shared_request get_msg_queue_shared_request;
     struct set_queue_fd_request set_queue_fd_request;
     struct set_queue_mask_request set_queue_mask_request;
     struct get_queue_status_request get_queue_status_request;
@@ -5806,6 +5872,7 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
@@ -5951,6 +6018,7 @@ union generic_reply
     struct empty_atom_table_reply empty_atom_table_reply;
     struct init_atom_table_reply init_atom_table_reply;
     struct get_msg_queue_reply get_msg_queue_reply;
+    struct get_msg_queue_shared_reply get_msg_queue_shared_reply;
     struct set_queue_fd_reply set_queue_fd_reply;
     struct set_queue_mask_reply set_queue_mask_reply;
     struct get_queue_status_reply get_queue_status_reply;
@@ -6077,6 +6145,7 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
@@ -6096,6 +6165,6 @@ union generic_reply
     struct terminate_job_reply terminate_job_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 481
+#define SERVER_PROTOCOL_VERSION 486
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
@@ -93,6 +93,7 @@ struct inotify_event {
 #define IN_CREATE        0x00000100
 #define IN_DELETE        0x00000200
 #define IN_DELETE_SELF   0x00000400
+#define IN_Q_OVERFLOW    0x00004000
 
 #define IN_ISDIR         0x40000000
 
@@ -139,6 +140,8 @@ struct dir
     int            want_data; /* return change data */
     int            subtree;  /* do we want to watch subdirectories? */
     struct list    change_records;   /* data for the change */
+    data_size_t    records_size; /* total size of the queued change records */
+    int            overflow; /* change records have been dropped */
     struct list    in_entry; /* entry in the inode dirs list */
     struct inode  *inode;    /* inode of the associated directory */
 };
@@ -615,6 +618,38 @@ static int inotify_get_poll_events( struct fd *fd )
     return POLLIN;
 }
 
+/* maximum size of the change records queued for a directory, like the largest Windows buffer */
+#define MAX_CHANGE_RECORDS_SIZE 0x10000
+/* number of most recent records checked for a duplicate modification */
+#define MAX_COALESCE_RECORDS 16
+
+/* check if a modification is already reported by one of the last queued records */
+static int is_duplicate_change( struct dir *dir, unsigned int action, const char *relpath, size_t len )
+{
+    struct change_record *record;
+    int count = 0;
+
+    if (action != FILE_ACTION_MODIFIED) return 0;
+
+    LIST_FOR_EACH_ENTRY_REV( record, &dir->change_records, struct change_record, entry )
+    {
+        if (++count > MAX_COALESCE_RECORDS) break;
+        if (record->event.len != len || memcmp( record->event.name, relpath, len )) continue;
+        return record->event.action == FILE_ACTION_MODIFIED;
+    }
+    return 0;
+}
+
+/* drop all the queued records, the client will have to rescan the directory */
+static void set_change_overflow( struct dir *dir )
+{
+    struct change_record *record;
+
+    while ((record = get_first_change_record( dir ))) free( record );
+    dir->records_size = 0;
+    dir->overflow = 1;
+}
+
 static void inotify_do_change_notify( struct dir *dir, unsigned int action,
                                       unsigned int cookie, const char *relpath )
 {
@@ -622,19 +657,30 @@ static void inotify_do_change_notify( struct dir *dir, unsigned int action,
 
     assert( dir->obj.ops == &dir_ops );
 
-    if (dir->want_data)
+    if (dir->want_data && !dir->overflow)
     {
         size_t len = strlen(relpath);
-        record = malloc( offsetof(struct change_record, event.name[len]) );
-        if (!record)
+        data_size_t size = offsetof(struct change_record, event.name[len]);
+
+        if (is_duplicate_change( dir, action, relpath, len ))
             return;
 
-        record->cookie = cookie;
-        record->event.action = action;
-        memcpy( record->event.name, relpath, len );
-        record->event.len = len;
+        if (dir->records_size + size > MAX_CHANGE_RECORDS_SIZE)
+            set_change_overflow( dir );
+        else
+        {
+            record = malloc( size );
+            if (!record)
+                return;
+
+            record->cookie = cookie;
+            record->event.action = action;
+            memcpy( record->event.name, relpath, len );
+            record->event.len = len;
 
-        list_add_tail( &dir->change_records, &record->entry );
+            list_add_tail( &dir->change_records, &record->entry );
+            dir->records_size += size;
+        }
     }
 
     fd_async_wake_up( dir->fd, ASYNC_TYPE_WAIT, STATUS_ALERTED );
@@ -805,7 +851,12 @@ static void inotify_notify_all( struct inotify_event *ie )
     else if (ie->mask & IN_MOVED_FROM)
         action = FILE_ACTION_RENAMED_OLD_NAME;
     else if (ie->mask & IN_MOVED_TO)
+    {
+        if (ie->mask & IN_ISDIR)
+            inode_check_dir( inode, ie->name );
+
         action = FILE_ACTION_RENAMED_NEW_NAME;
+    }
     else
         action = FILE_ACTION_MODIFIED;
 
@@ -837,10 +888,22 @@ static void inotify_notify_all( struct inotify_event *ie )
     }
 }
 
+/* the kernel dropped events, all watching directories have to be rescanned */
+static void inotify_notify_overflow(void)
+{
+    struct dir *dir;
+
+    LIST_FOR_EACH_ENTRY( dir, &change_list, struct dir, entry )
+    {
+        if (dir->want_data) set_change_overflow( dir );
+        fd_async_wake_up( dir->fd, ASYNC_TYPE_WAIT, STATUS_ALERTED );
+    }
+}
+
 static void inotify_poll_event( struct fd *fd, int event )
 {
     int r, ofs, unix_fd;
-    char buffer[0x1000];
+    static char buffer[0x10000];  /* read as many events as possible at once */
     struct inotify_event *ie;
 
     unix_fd = get_unix_fd( fd );
@@ -854,6 +917,11 @@ static void inotify_poll_event( struct fd *fd, int event )
     for( ofs = 0; ofs < r - offsetof(struct inotify_event, name); )
     {
         ie = (struct inotify_event*) &buffer[ofs];
+        if (ie->mask & IN_Q_OVERFLOW)
+        {
+            inotify_notify_overflow();
+            break;
+        }
         if (!ie->len)
             break;
         ofs += offsetof( struct inotify_event, name[ie->len] );
@@ -1094,6 +1162,8 @@ struct object *create_dir_obj( struct fd *fd, unsigned int access, mode_t mode )
         return NULL;
 
     list_init( &dir->change_records );
+    dir->records_size = 0;
+    dir->overflow = 0;
     dir->filter = 0;
     dir->notified = 0;
     dir->want_data = 0;
@@ -1139,7 +1209,7 @@ DECL_HANDLER(read_directory_changes)
     }
 
     /* if there's already a change in the queue, send it */
-    if (!list_empty( &dir->change_records ))
+    if (!list_empty( &dir->change_records ) || dir->overflow)
         fd_async_wake_up( dir->fd, ASYNC_TYPE_WAIT, STATUS_ALERTED );
 
     /* setup the real notification */
@@ -1165,8 +1235,17 @@ DECL_HANDLER(read_change)
     if (!dir)
         return;
 
+    if (dir->overflow)
+    {
+        dir->overflow = 0;
+        release_object( dir );
+        set_error( STATUS_NOTIFY_ENUM_DIR );
+        return;
+    }
+
     list_init( &events );
     list_move_tail( &events, &dir->change_records );
+    dir->records_size = 0;
     release_object( dir );
 
     if (list_empty( &events ))
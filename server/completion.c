@@ -253,6 +253,39 @@ DECL_HANDLER(remove_completion)
     release_object( completion );
 }
 
+/* get several completions from completion port queue */
+DECL_HANDLER(remove_completions)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    completion_msg_t *msgs;
+    unsigned int i, count;
+
+    if (!completion) return;
+
+    count = min( get_reply_max_size() / sizeof(*msgs), completion->depth );
+    if (!count)
+        set_error( STATUS_PENDING );
+    else if ((msgs = set_reply_data_size( count * sizeof(*msgs) )))
+    {
+        for (i = 0; i < count; i++)
+        {
+            struct list *entry = list_head( &completion->queue );
+            struct comp_msg *msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
+
+            list_remove( entry );
+            msgs[i].ckey        = msg->ckey;
+            msgs[i].cvalue      = msg->cvalue;
+            msgs[i].information = msg->information;
+            msgs[i].status      = msg->status;
+            msgs[i].__pad       = 0;
+            free( msg );
+        }
+        completion->depth -= count;
+    }
+
+    release_object( completion );
+}
+
 /* get queue depth for completion port */
 DECL_HANDLER(query_completion)
 {
@@ -347,13 +347,17 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct list           entry;      /* entry in expired list */
+    int                   index;      /* index in timeout heap, -1 once expired */
     timeout_t             when;       /* timeout expiry (absolute time) */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list timeout_list = LIST_INIT(timeout_list);   /* sorted timeouts list */
+static struct timeout_user **timeout_heap;  /* binary heap of pending timeouts, earliest first */
+static int timeout_count;                   /* number of pending timeouts */
+static int timeout_size;                    /* allocated size of the heap */
+static struct list expired_list = LIST_INIT(expired_list);  /* expired timeouts whose callback is pending */
 timeout_t current_time;
 
 static inline void set_current_time(void)
@@ -364,32 +368,89 @@ static inline void set_current_time(void)
     current_time = (timeout_t)now.tv_sec * TICKS_PER_SEC + now.tv_usec * 10 + ticks_1601_to_1970;
 }
 
+/* store a timeout at a given heap position */
+static inline void set_timeout_heap( int index, struct timeout_user *user )
+{
+    timeout_heap[index] = user;
+    user->index = index;
+}
+
+/* move a timeout towards the top of the heap until its parent expires earlier */
+static void timeout_heap_up( int index, struct timeout_user *user )
+{
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (timeout_heap[parent]->when <= user->when) break;
+        set_timeout_heap( index, timeout_heap[parent] );
+        index = parent;
+    }
+    set_timeout_heap( index, user );
+}
+
+/* move a timeout towards the bottom of the heap until its children expire later */
+static void timeout_heap_down( int index, struct timeout_user *user )
+{
+    for (;;)
+    {
+        int child = 2 * index + 1;
+        if (child >= timeout_count) break;
+        if (child + 1 < timeout_count && timeout_heap[child + 1]->when < timeout_heap[child]->when)
+            child++;
+        if (user->when <= timeout_heap[child]->when) break;
+        set_timeout_heap( index, timeout_heap[child] );
+        index = child;
+    }
+    set_timeout_heap( index, user );
+}
+
+/* remove the timeout at a given heap position */
+static void timeout_heap_remove( int index )
+{
+    struct timeout_user *last = timeout_heap[--timeout_count];
+
+    timeout_heap[index]->index = -1;
+    if (index == timeout_count) return;
+    if (index > 0 && last->when < timeout_heap[(index - 1) / 2]->when)
+        timeout_heap_up( index, last );
+    else
+        timeout_heap_down( index, last );
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
+
+    if (timeout_count == timeout_size)
+    {
+        int new_size = max( timeout_size * 2, 64 );
+        struct timeout_user **new_heap = realloc( timeout_heap, new_size * sizeof(*new_heap) );
+        if (!new_heap)
+        {
+            set_error( STATUS_NO_MEMORY );
+            return NULL;
+        }
+        timeout_heap = new_heap;
+        timeout_size = new_size;
+    }
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = (when > 0) ? when : current_time - when;
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
+    /* Now insert it in the heap */
 
-    LIST_FOR_EACH( ptr, &timeout_list )
-    {
-        struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-        if (timeout->when >= user->when) break;
-    }
-    list_add_before( ptr, &user->entry );
+    timeout_heap_up( timeout_count++, user );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->index == -1) list_remove( &user->entry );
+    else timeout_heap_remove( user->index );
     free( user );
 }
 
@@ -835,23 +896,17 @@ static void remove_poll_user( struct fd *fd, int user )
 /* process pending timeouts and return the time until the next timeout, in milliseconds */
 static int get_next_timeout(void)
 {
-    if (!list_empty( &timeout_list ))
+    if (timeout_count)
     {
-        struct list expired_list, *ptr;
+        struct list *ptr;
 
-        /* first remove all expired timers from the list */
+        /* first remove all expired timers from the heap */
 
-        list_init( &expired_list );
-        while ((ptr = list_head( &timeout_list )) != NULL)
+        while (timeout_count && timeout_heap[0]->when <= current_time)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            struct timeout_user *timeout = timeout_heap[0];
+            timeout_heap_remove( 0 );
+            list_add_tail( &expired_list, &timeout->entry );
         }
 
         /* now call the callback for all the removed timers */
@@ -864,10 +919,9 @@ static int get_next_timeout(void)
             free( timeout );
         }
 
-        if ((ptr = list_head( &timeout_list )) != NULL)
+        if (timeout_count)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            int diff = (timeout->when - current_time + 9999) / 10000;
+            int diff = (timeout_heap[0]->when - current_time + 9999) / 10000;
             if (diff < 0) diff = 0;
             return diff;
         }
@@ -42,7 +42,7 @@
 struct handle_entry
 {
     struct object *ptr;       /* object */
-    unsigned int   access;    /* access rights */
+    unsigned int   access;    /* access rights, or next free entry if ptr is NULL */
 };
 
 struct handle_table
@@ -51,7 +51,7 @@ struct handle_table
     struct process      *process;     /* process owning this table */
     int                  count;       /* number of allocated entries */
     int                  last;        /* last used entry */
-    int                  free;        /* first entry that may be free */
+    int                  free;        /* first entry of the free list, -1 if empty */
     struct handle_entry *entries;     /* handle entries */
 };
 
@@ -205,7 +205,7 @@ struct handle_table *alloc_handle_table( struct process *process, int count )
     table->process = process;
     table->count   = count;
     table->last    = -1;
-    table->free    = 0;
+    table->free    = -1;
     if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
     release_object( table );
     return NULL;
@@ -228,21 +228,42 @@ static int grow_handle_table( struct handle_table *table )
     return 1;
 }
 
-/* allocate the first free entry in the handle table */
+/* rebuild the free list from the unused entries up to table->last */
+static void rebuild_free_list( struct handle_table *table )
+{
+    int i;
+
+    table->free = -1;
+    for (i = table->last; i >= 0; i--)
+    {
+        if (table->entries[i].ptr) continue;
+        table->entries[i].access = table->free;
+        table->free = i;
+    }
+}
+
+/* allocate a free entry in the handle table */
 static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
 {
-    struct handle_entry *entry = table->entries + table->free;
+    struct handle_entry *entry;
     int i;
 
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
-    if (i >= table->count)
+    if (table->free != -1)
+    {
+        /* reuse the most recently freed entry */
+        i = table->free;
+        entry = table->entries + i;
+        table->free = entry->access;
+        if (i > table->last) table->last = i;
+    }
+    else
     {
-        if (!grow_handle_table( table )) return 0;
-        entry = table->entries + i;  /* the entries may have moved */
+        /* all the entries up to last are in use, append a new one */
+        i = table->last + 1;
+        if (i >= table->count && !grow_handle_table( table )) return 0;
+        entry = table->entries + i;
+        table->last = i;
     }
-    table->last = i;
- found:
-    table->free = i + 1;
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
     return index_to_handle(i);
@@ -346,6 +367,8 @@ static void shrink_handle_table( struct handle_table *table )
     if (!(new_entries = realloc( table->entries, count * sizeof(*new_entries) ))) return;
     table->count   = count;
     table->entries = new_entries;
+    /* the free list may point past the end of the new table */
+    rebuild_free_list( table );
 }
 
 /* copy the handle table of the parent process */
@@ -375,6 +398,7 @@ struct handle_table *copy_handle_table( struct process *process, struct process
     }
     /* attempt to shrink the table */
     shrink_handle_table( table );
+    rebuild_free_list( table );
     return table;
 }
 
@@ -391,7 +415,8 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
     entry->ptr = NULL;
     table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
+    entry->access = table->free;
+    table->free = entry - table->entries;
     if (entry == table->entries + table->last) shrink_handle_table( table );
     release_object_from_handle( obj );
     return STATUS_SUCCESS;
@@ -67,6 +67,11 @@ struct mapping
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct file    *shared_file;     /* temp file for shared PE mapping */
     struct list     shared_entry;    /* entry in global shared PE mappings list */
+    struct file    *image_file;      /* temp file with the page-aligned layout of an unaligned PE image */
+    struct list     image_entry;     /* entry in global image layouts list */
+    file_pos_t      image_file_size; /* size of the PE file when the layout was built */
+    timeout_t       image_file_mtime; /* modification time of the PE file when the layout was built */
+    timeout_t       image_file_ctime; /* status change time of the PE file when the layout was built */
 };
 
 static void mapping_dump( struct object *obj, int verbose );
@@ -111,6 +116,7 @@ static const struct fd_ops mapping_fd_ops =
 };
 
 static struct list shared_list = LIST_INIT(shared_list);
+static struct list image_list = LIST_INIT(image_list);
 
 static size_t page_mask;
 
@@ -369,6 +375,126 @@ static int build_shared_mapping( struct mapping *mapping, int fd,
     return 0;
 }
 
+/* file times with full precision, a file rewritten within the same second must not match */
+static timeout_t get_file_mtime( const struct stat *st )
+{
+    timeout_t ret = (timeout_t)st->st_mtime * TICKS_PER_SEC;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    ret += st->st_mtim.tv_nsec / 100;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    ret += st->st_mtimespec.tv_nsec / 100;
+#endif
+    return ret;
+}
+
+static timeout_t get_file_ctime( const struct stat *st )
+{
+    timeout_t ret = (timeout_t)st->st_ctime * TICKS_PER_SEC;
+#ifdef HAVE_STRUCT_STAT_ST_CTIM
+    ret += st->st_ctim.tv_nsec / 100;
+#elif defined(HAVE_STRUCT_STAT_ST_CTIMESPEC)
+    ret += st->st_ctimespec.tv_nsec / 100;
+#endif
+    return ret;
+}
+
+/* find an up-to-date image layout for a given mapping */
+static struct file *get_image_file( struct mapping *mapping, const struct stat *st )
+{
+    struct mapping *ptr;
+
+    LIST_FOR_EACH_ENTRY( ptr, &image_list, struct mapping, image_entry )
+    {
+        if (ptr->image_file_size != st->st_size) continue;
+        if (ptr->image_file_mtime != get_file_mtime( st )) continue;
+        if (ptr->image_file_ctime != get_file_ctime( st )) continue;
+        if (is_same_file_fd( ptr->fd, mapping->fd ))
+            return (struct file *)grab_object( ptr->image_file );
+    }
+    return NULL;
+}
+
+/* build the page-aligned layout of the sections that the client would otherwise have to read
+ * into private memory, so that all processes mapping the image share the same pages */
+static void build_image_layout( struct mapping *mapping, int fd, unsigned int section_align,
+                                IMAGE_SECTION_HEADER *sec, unsigned int nb_sec )
+{
+    unsigned int i;
+    size_t file_size, map_size, max_size;
+    off_t read_pos;
+    char *buffer = NULL;
+    int image_fd;
+    long toread;
+    struct stat st;
+
+    /* check if any section is misaligned in the file */
+
+    if (section_align <= page_mask) return;  /* the whole file is mapped as is */
+
+    max_size = 0;
+    for (i = 0; i < nb_sec; i++)
+    {
+        if ((sec[i].Characteristics & IMAGE_SCN_MEM_SHARED) &&
+            (sec[i].Characteristics & IMAGE_SCN_MEM_WRITE)) continue;
+        if (!sec[i].PointerToRawData) continue;
+        get_section_sizes( &sec[i], &map_size, &read_pos, &file_size );
+        if (!file_size || !(read_pos & page_mask)) continue;
+        if (sec[i].VirtualAddress & page_mask) return;  /* not mapped section by section */
+        if (sec[i].VirtualAddress + file_size > mapping->size) return;
+        if (file_size > max_size) max_size = file_size;
+    }
+    if (!max_size) return;  /* nothing to do */
+
+    if (fstat( fd, &st ) == -1) return;
+    if ((mapping->image_file = get_image_file( mapping, &st ))) goto done;
+
+    /* create a temp file for the layout */
+
+    if ((image_fd = create_temp_file( mapping->size )) == -1) return;
+    if (!(mapping->image_file = create_file_for_fd( image_fd, FILE_GENERIC_READ|FILE_GENERIC_WRITE, 0 )))
+        return;
+
+    if (!(buffer = malloc( max_size ))) goto error;
+
+    /* copy the misaligned sections data to their virtual address in the temp file */
+
+    for (i = 0; i < nb_sec; i++)
+    {
+        if ((sec[i].Characteristics & IMAGE_SCN_MEM_SHARED) &&
+            (sec[i].Characteristics & IMAGE_SCN_MEM_WRITE)) continue;
+        if (!sec[i].PointerToRawData) continue;
+        get_section_sizes( &sec[i], &map_size, &read_pos, &file_size );
+        if (!file_size || !(read_pos & page_mask)) continue;
+        toread = file_size;
+        while (toread)
+        {
+            long res = pread( fd, buffer + file_size - toread, toread, read_pos );
+            if (!res && toread < 0x200)  /* partial sector at EOF is not an error */
+            {
+                file_size -= toread;
+                break;
+            }
+            if (res <= 0) goto error;
+            toread -= res;
+            read_pos += res;
+        }
+        if (pwrite( image_fd, buffer, file_size, sec[i].VirtualAddress ) != file_size) goto error;
+    }
+    free( buffer );
+
+ done:
+    mapping->image_file_size  = st.st_size;
+    mapping->image_file_mtime = get_file_mtime( &st );
+    mapping->image_file_ctime = get_file_ctime( &st );
+    list_add_head( &image_list, &mapping->image_entry );
+    return;
+
+ error:
+    release_object( mapping->image_file );
+    mapping->image_file = NULL;
+    free( buffer );
+}
+
 /* retrieve the mapping parameters for an executable (PE) image */
 static unsigned int get_image_params( struct mapping *mapping, int unix_fd, int protect )
 {
@@ -386,6 +512,7 @@ static unsigned int get_image_params( struct mapping *mapping, int unix_fd, int
     } nt;
     off_t pos;
     int size;
+    unsigned int section_align = 0;
 
     /* load the headers */
 
@@ -438,11 +565,13 @@ static unsigned int get_image_params( struct mapping *mapping, int unix_fd, int
         mapping->size        = ROUND_SIZE( nt.opt.hdr32.SizeOfImage );
         mapping->base        = nt.opt.hdr32.ImageBase;
         mapping->header_size = nt.opt.hdr32.SizeOfHeaders;
+        section_align        = nt.opt.hdr32.SectionAlignment;
         break;
     case IMAGE_NT_OPTIONAL_HDR64_MAGIC:
         mapping->size        = ROUND_SIZE( nt.opt.hdr64.SizeOfImage );
         mapping->base        = nt.opt.hdr64.ImageBase;
         mapping->header_size = nt.opt.hdr64.SizeOfHeaders;
+        section_align        = nt.opt.hdr64.SectionAlignment;
         break;
     }
 
@@ -459,6 +588,8 @@ static unsigned int get_image_params( struct mapping *mapping, int unix_fd, int
 
     if (mapping->shared_file) list_add_head( &shared_list, &mapping->shared_entry );
 
+    build_image_layout( mapping, unix_fd, section_align, sec, nt.FileHeader.NumberOfSections );
+
     mapping->protect = protect;
     free( sec );
     return 0;
@@ -494,6 +625,7 @@ static struct object *create_mapping( struct directory *root, const struct unico
     mapping->base        = 0;
     mapping->fd          = NULL;
     mapping->shared_file = NULL;
+    mapping->image_file  = NULL;
     mapping->committed   = NULL;
 
     if (protect & VPROT_READ) access |= FILE_READ_DATA;
@@ -599,15 +731,37 @@ struct mapping *grab_mapping_unless_removable( struct mapping *mapping )
     return (struct mapping *)grab_object( mapping );
 }
 
+/* create an anonymous mapping that is also mapped in the server, to share data with clients */
+struct mapping *create_shared_mapping( mem_size_t size, void **ptr )
+{
+    struct mapping *mapping;
+    int unix_fd;
+
+    if (!(mapping = (struct mapping *)create_mapping( NULL, NULL, 0, size,
+                                                      VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, 0, NULL )))
+        return NULL;
+    if ((unix_fd = get_unix_fd( mapping->fd )) == -1) goto error;
+    if ((*ptr = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, unix_fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        goto error;
+    }
+    return mapping;
+
+ error:
+    release_object( mapping );
+    return NULL;
+}
+
 static void mapping_dump( struct object *obj, int verbose )
 {
     struct mapping *mapping = (struct mapping *)obj;
     assert( obj->ops == &mapping_ops );
     fprintf( stderr, "Mapping size=%08x%08x prot=%08x fd=%p header_size=%08x base=%08lx "
-             "shared_file=%p ",
+             "shared_file=%p image_file=%p ",
              (unsigned int)(mapping->size >> 32), (unsigned int)mapping->size,
              mapping->protect, mapping->fd, mapping->header_size,
-             (unsigned long)mapping->base, mapping->shared_file );
+             (unsigned long)mapping->base, mapping->shared_file, mapping->image_file );
     dump_object_name( &mapping->obj );
     fputc( '\n', stderr );
 }
@@ -644,6 +798,11 @@ static void mapping_destroy( struct object *obj )
         release_object( mapping->shared_file );
         list_remove( &mapping->shared_entry );
     }
+    if (mapping->image_file)
+    {
+        release_object( mapping->image_file );
+        list_remove( &mapping->image_entry );
+    }
     free( mapping->committed );
 }
 
@@ -730,6 +889,7 @@ DECL_HANDLER(get_mapping_info)
     reply->header_size = mapping->header_size;
     reply->base        = mapping->base;
     reply->shared_file = 0;
+    reply->image_file  = 0;
     if ((fd = get_obj_fd( &mapping->obj )))
     {
         if (!is_fd_removable(fd)) reply->mapping = alloc_handle( current->process, mapping, 0, 0 );
@@ -743,6 +903,12 @@ DECL_HANDLER(get_mapping_info)
             if (reply->mapping) close_handle( current->process, reply->mapping );
         }
     }
+    if (mapping->image_file && !get_error())
+    {
+        /* the layout is only an optimization, the client falls back to reading the file */
+        if (!(reply->image_file = alloc_handle( current->process, mapping->image_file, GENERIC_READ, 0 )))
+            clear_error();
+    }
     release_object( mapping );
 }
 
@@ -25,6 +25,9 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_POLL_H
 # include <poll.h>
 #endif
@@ -35,6 +38,7 @@
 #include "winbase.h"
 #include "wingdi.h"
 #include "winuser.h"
+#include "dde.h"
 #include "winternl.h"
 
 #include "handle.h"
@@ -140,6 +144,8 @@ struct msg_queue
     struct thread_input   *input;           /* thread input descriptor */
     struct hook_table     *hooks;           /* hook table */
     timeout_t              last_get_msg;    /* time of last get message call */
+    struct mapping        *shared_mapping;  /* mapping of the state shared with the client */
+    struct queue_shared_data *shared;       /* state shared with the client */
 };
 
 struct hotkey
@@ -294,6 +300,8 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->input           = (struct thread_input *)grab_object( input );
         queue->hooks           = NULL;
         queue->last_get_msg    = current_time;
+        queue->shared_mapping  = NULL;
+        queue->shared          = NULL;
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
@@ -436,6 +444,7 @@ static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    if (queue->shared) queue->shared->wake_bits = queue->wake_bits;
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -444,6 +453,7 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
 {
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
+    if (queue->shared) queue->shared->wake_bits = queue->wake_bits;
 }
 
 /* check whether msg is a keyboard message */
@@ -774,10 +784,96 @@ static int match_window( user_handle_t win, user_handle_t msg_win )
     return is_child_window( win, msg_win );
 }
 
+/* check whether a posted message can be returned to the client ahead of time */
+static inline int is_prefetchable_message( const struct message *msg )
+{
+    if (msg->type != MSG_POSTED || msg->data_size) return 0;
+    if (msg->msg & 0x80000000) return 0;  /* internal message */
+    if (msg->msg == WM_HOTKEY) return 0;
+    return (msg->msg < WM_DDE_FIRST || msg->msg > WM_DDE_LAST);
+}
+
+/* remove the posted messages following a retrieved one and return them in the reply data */
+static void prefetch_posted_messages( struct msg_queue *queue, struct message *first_msg,
+                                      unsigned int max, struct get_message_reply *reply )
+{
+    struct list *ptr;
+    struct posted_msg_data *data;
+    unsigned int i, count = 0;
+
+    max = min( max, get_reply_max_size() / sizeof(*data) );
+    for (ptr = list_next( &queue->msg_list[POST_MESSAGE], &first_msg->entry ); ptr && count < max;
+         ptr = list_next( &queue->msg_list[POST_MESSAGE], ptr ))
+    {
+        if (!is_prefetchable_message( LIST_ENTRY( ptr, struct message, entry ))) break;
+        count++;
+    }
+    if (!count || !(data = set_reply_data_size( count * sizeof(*data) ))) return;
+
+    for (i = 0; i < count; i++)
+    {
+        struct message *msg;
+
+        ptr = list_next( &queue->msg_list[POST_MESSAGE], &first_msg->entry );
+        msg = LIST_ENTRY( ptr, struct message, entry );
+        data[i].win    = msg->win;
+        data[i].msg    = msg->msg;
+        data[i].wparam = msg->wparam;
+        data[i].lparam = msg->lparam;
+        data[i].x      = msg->x;
+        data[i].y      = msg->y;
+        data[i].time   = msg->time;
+        data[i].__pad  = 0;
+        remove_queue_message( queue, msg, POST_MESSAGE );
+    }
+    reply->prefetched = count;
+}
+
+/* put back at the head of the queue the prefetched messages the client didn't retrieve */
+static void requeue_posted_messages( struct msg_queue *queue, const void *data, data_size_t size )
+{
+    struct posted_msg_data posted;
+    struct message *msg;
+    struct thread *thread;
+    unsigned int count = size / sizeof(posted);
+
+    while (count--)  /* the last one goes first since they are added at the head */
+    {
+        memcpy( &posted, (const char *)data + count * sizeof(posted), sizeof(posted) );
+        if (posted.win)
+        {
+            if (!(thread = get_window_thread( posted.win ))) continue;  /* window was destroyed */
+            release_object( thread );
+            if (thread != current) continue;
+        }
+        if (!(msg = mem_alloc( sizeof(*msg) ))) return;
+
+        msg->type      = MSG_POSTED;
+        msg->win       = posted.win;
+        msg->msg       = posted.msg;
+        msg->wparam    = posted.wparam;
+        msg->lparam    = posted.lparam;
+        msg->x         = posted.x;
+        msg->y         = posted.y;
+        msg->time      = posted.time;
+        msg->data      = NULL;
+        msg->data_size = 0;
+        msg->unique_id = 0;
+        msg->result    = NULL;
+        if (!is_prefetchable_message( msg ))
+        {
+            free( msg );
+            continue;
+        }
+        list_add_head( &queue->msg_list[POST_MESSAGE], &msg->entry );
+        set_queue_bits( queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
+    }
+}
+
 /* retrieve a posted message */
 static int get_posted_message( struct msg_queue *queue, user_handle_t win,
                                unsigned int first, unsigned int last, unsigned int flags,
-                               struct get_message_reply *reply )
+                               unsigned int prefetch, struct get_message_reply *reply )
 {
     struct message *msg;
 
@@ -815,6 +911,8 @@ found:
             msg->data = NULL;
             msg->data_size = 0;
         }
+        else if (prefetch && !win && !first && last == ~0U && is_prefetchable_message( msg ))
+            prefetch_posted_messages( queue, msg, prefetch, reply );
         remove_queue_message( queue, msg, POST_MESSAGE );
     }
     else if (msg->data) set_reply_data( msg->data, msg->data_size );
@@ -991,6 +1089,8 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    if (queue->shared) munmap( queue->shared, sizeof(*queue->shared) );
+    if (queue->shared_mapping) release_object( queue->shared_mapping );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -2191,6 +2291,24 @@ DECL_HANDLER(get_msg_queue)
 }
 
 
+/* get a mapping of the shared state of the current thread queue */
+DECL_HANDLER(get_msg_queue_shared)
+{
+    struct msg_queue *queue = get_current_queue();
+    void *ptr;
+
+    if (!queue) return;
+    if (!queue->shared_mapping)
+    {
+        if (!(queue->shared_mapping = create_shared_mapping( sizeof(*queue->shared), &ptr ))) return;
+        queue->shared = ptr;
+        queue->shared->wake_bits = queue->wake_bits;
+    }
+    reply->handle = alloc_handle( current->process, queue->shared_mapping,
+                                  SECTION_QUERY | SECTION_MAP_READ, 0 );
+}
+
+
 /* set the file descriptor associated to the current thread queue */
 DECL_HANDLER(set_queue_fd)
 {
@@ -2405,6 +2523,8 @@ DECL_HANDLER(get_message)
     queue->last_get_msg = current_time;
     if (!filter) filter = QS_ALLINPUT;
 
+    if (get_req_data_size()) requeue_posted_messages( queue, get_req_data(), get_req_data_size() );
+
     /* first check for sent messages */
     if ((ptr = list_head( &queue->msg_list[SEND_MESSAGE] )))
     {
@@ -2424,12 +2544,13 @@ DECL_HANDLER(get_message)
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
-        get_posted_message( queue, get_win, req->get_first, req->get_last, req->flags, reply ))
+        get_posted_message( queue, get_win, req->get_first, req->get_last, req->flags,
+                            req->prefetch, reply ))
         return;
 
     if ((filter & QS_HOTKEY) && queue->hotkey_count &&
         req->get_first <= WM_HOTKEY && req->get_last >= WM_HOTKEY &&
-        get_posted_message( queue, get_win, WM_HOTKEY, WM_HOTKEY, req->flags, reply ))
+        get_posted_message( queue, get_win, WM_HOTKEY, WM_HOTKEY, req->flags, 0, reply ))
         return;
 
     /* only check for quit messages if not posted messages pending */
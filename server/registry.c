@@ -72,6 +72,10 @@ struct key
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
     struct key      **subkeys;     /* subkeys array */
+    struct key      **subkey_hash; /* hash table of subkeys (only for keys with many subkeys) */
+    unsigned int      hash_size;   /* size of the subkey hash table */
+    unsigned int      hash;        /* hash of the key name */
+    struct key       *hash_next;   /* next key in the parent hash bucket */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
@@ -99,9 +103,11 @@ struct key_value
 };
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
+#define MIN_HASHED_SUBKEYS 64  /* min. number of subkeys to use a hash table */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
 
 #define MAX_NAME_LEN  255    /* max. length of a key name */
+#define IO_BUFFER_SIZE 0x40000  /* stdio buffer size for registry files */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
 
 /* the root of the registry tree */
@@ -203,6 +209,7 @@ static void dump_value( const struct key_value *value, FILE *f )
 {
     unsigned int i, dw;
     int count;
+    char buffer[256], *pos = buffer;
 
     if (value->namelen)
     {
@@ -238,18 +245,30 @@ static void dump_value( const struct key_value *value, FILE *f )
     else count += fprintf( f, "hex(%x):", value->type );
     for (i = 0; i < value->len; i++)
     {
-        count += fprintf( f, "%02x", *((unsigned char *)value->data + i) );
+        static const char hex[] = "0123456789abcdef";
+        unsigned char byte = *((unsigned char *)value->data + i);
+
+        if (pos > buffer + sizeof(buffer) - 8)
+        {
+            fwrite( buffer, pos - buffer, 1, f );
+            pos = buffer;
+        }
+        *pos++ = hex[byte >> 4];
+        *pos++ = hex[byte & 0x0f];
+        count += 2;
         if (i < value->len-1)
         {
-            fputc( ',', f );
+            *pos++ = ',';
             if (++count > 76)
             {
-                fprintf( f, "\\\n  " );
+                memcpy( pos, "\\\n  ", 4 );
+                pos += 4;
                 count = 2;
             }
         }
     }
-    fputc( '\n', f );
+    *pos++ = '\n';
+    fwrite( buffer, pos - buffer, 1, f );
 }
 
 /* save a registry and all its subkeys to a text file */
@@ -413,6 +432,7 @@ static void key_destroy( struct object *obj )
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free( key->subkey_hash );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -462,6 +482,15 @@ static struct unicode_str *get_path_token( const struct unicode_str *path, struc
     return token;
 }
 
+/* case-insensitive hash of a key name */
+static unsigned int hash_key_name( const struct unicode_str *name )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < name->len / sizeof(WCHAR); i++) hash = hash * 65599 + tolowerW( name->str[i] );
+    return hash;
+}
+
 /* allocate a key object */
 static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
 {
@@ -476,6 +505,10 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->last_subkey = -1;
         key->nb_subkeys  = 0;
         key->subkeys     = NULL;
+        key->subkey_hash = NULL;
+        key->hash_size   = 0;
+        key->hash        = hash_key_name( name );
+        key->hash_next   = NULL;
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
@@ -565,6 +598,40 @@ static int grow_subkeys( struct key *key )
     return 1;
 }
 
+/* add a subkey to the hash table of its parent */
+static void add_subkey_hash( struct key *parent, struct key *key )
+{
+    struct key **bucket = &parent->subkey_hash[key->hash & (parent->hash_size - 1)];
+
+    key->hash_next = *bucket;
+    *bucket = key;
+}
+
+/* remove a subkey from the hash table of its parent */
+static void remove_subkey_hash( struct key *parent, struct key *key )
+{
+    struct key **ptr = &parent->subkey_hash[key->hash & (parent->hash_size - 1)];
+
+    while (*ptr != key) ptr = &(*ptr)->hash_next;
+    *ptr = key->hash_next;
+    key->hash_next = NULL;
+}
+
+/* (re)build the subkey hash table once a key has many subkeys; return 1 if OK, 0 on error */
+static int grow_subkey_hash( struct key *key )
+{
+    struct key **new_hash;
+    unsigned int i, hash_size = key->hash_size ? key->hash_size * 2 : MIN_HASHED_SUBKEYS * 2;
+
+    if (!(new_hash = mem_alloc( hash_size * sizeof(*new_hash) ))) return 0;
+    memset( new_hash, 0, hash_size * sizeof(*new_hash) );
+    free( key->subkey_hash );
+    key->subkey_hash = new_hash;
+    key->hash_size   = hash_size;
+    for (i = 0; i <= key->last_subkey; i++) add_subkey_hash( key, key->subkeys[i] );
+    return 1;
+}
+
 /* allocate a subkey for a given key, and return its index */
 static struct key *alloc_subkey( struct key *parent, const struct unicode_str *name,
                                  int index, timeout_t modif )
@@ -582,12 +649,17 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
         /* need to grow the array */
         if (!grow_subkeys( parent )) return NULL;
     }
+    if (parent->last_subkey + 1 >= (parent->hash_size ? parent->hash_size : MIN_HASHED_SUBKEYS))
+    {
+        if (!grow_subkey_hash( parent )) return NULL;
+    }
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
         for (i = ++parent->last_subkey; i > index; i--)
             parent->subkeys[i] = parent->subkeys[i-1];
         parent->subkeys[index] = key;
+        if (parent->subkey_hash) add_subkey_hash( parent, key );
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -606,6 +678,7 @@ static void free_subkey( struct key *parent, int index )
     key = parent->subkeys[index];
     for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
     parent->last_subkey--;
+    if (parent->subkey_hash) remove_subkey_hash( parent, key );
     key->flags |= KEY_DELETED;
     key->parent = NULL;
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
@@ -625,11 +698,26 @@ static void free_subkey( struct key *parent, int index )
 }
 
 /* find the named child of a given key and return its index */
+/* the index is only meaningful when the key is not found, as the insertion point */
 static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_hash)
+    {
+        unsigned int hash = hash_key_name( name );
+        struct key *subkey;
+
+        for (subkey = key->subkey_hash[hash & (key->hash_size - 1)]; subkey; subkey = subkey->hash_next)
+        {
+            if (subkey->hash != hash || subkey->namelen != name->len) continue;
+            if (memicmpW( subkey->name, name->str, name->len / sizeof(WCHAR) )) continue;
+            *index = -1;
+            return subkey;
+        }
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -1436,15 +1524,20 @@ static int parse_hex( unsigned char *dest, data_size_t *len, const char *buffer
 {
     const char *p = buffer;
     data_size_t count = 0;
-    char *end;
 
     while (isxdigit(*p))
     {
-        unsigned int val = strtoul( p, &end, 16 );
-        if (end == p || val > 0xff) return -1;
+        unsigned int val = 0;
+
+        while (isxdigit(*p))
+        {
+            if (*p <= '9') val = val * 16 + *p - '0';
+            else val = val * 16 + (*p | 0x20) - 'a' + 10;
+            if (val > 0xff) return -1;
+            p++;
+        }
         if (count++ >= *len) return -1;  /* dest buffer overflow */
         *dest++ = val;
-        p = end;
         while (isspace(*p)) p++;
         if (*p == ',') p++;
         while (isspace(*p)) p++;
@@ -1591,6 +1684,8 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     struct file_load_info info;
     char *p;
 
+    setvbuf( f, NULL, _IOFBF, IO_BUFFER_SIZE );
+
     info.filename = filename;
     info.file   = f;
     info.len    = 4;
@@ -1820,6 +1915,7 @@ void init_registry(void)
 /* save a registry branch to a file */
 static void save_all_subkeys( struct key *key, FILE *f )
 {
+    setvbuf( f, NULL, _IOFBF, IO_BUFFER_SIZE );
     fprintf( f, "WINE REGISTRY Version 2\n" );
     fprintf( f, ";; All keys relative to " );
     dump_path( key, NULL, f );